@@ -223,6 +223,33 @@ int Fl::event_inside(const Fl_Widget *o) /*const*/ {
 // timer support
 //
 
+#if defined(WIN32)
+#  include <mmsystem.h>
+#else
+#  include <time.h>
+#  include <sys/time.h>
+#endif
+
+// Seconds on a clock which is not affected by changes of the system
+// time, used for timeouts and frame pacing:
+static double monotonic_clock() {
+#if defined(WIN32)
+  return timeGetTime() / 1000.0;
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+}
+
+// Lateness of the timeout callbacks, see Fl::timeout_stats():
+static unsigned timeout_calls;
+static double timeout_late_sum, timeout_late_max;
+
 #ifdef WIN32
 
 // implementation in Fl_win32.cxx
@@ -239,42 +266,121 @@ int Fl::event_inside(const Fl_Widget *o) /*const*/ {
 
 
 ////////////////////////////////////////////////////////////////////////
-// Timeouts are stored in a sorted list (*first_timeout), so only the
-// first one needs to be checked to see if any should be called.
-// Allocated, but unused (free) Timeout structs are stored in another
+// Timeouts are stored in a binary heap (timeout_heap) ordered by their
+// absolute deadline on the monotonic clock, so only the first one
+// needs to be checked to see if any should be called, and adding or
+// removing one is O(log n). Timeouts with the same deadline are called
+// in the order they were added. Every timeout is also entered in a hash
+// table on its callback and argument (timeout_hash), so has_timeout()
+// and remove_timeout() do not have to search the heap.
+// Allocated, but unused (free) Timeout structs are stored in a
 // linked list (*free_timeout).
 
 struct Timeout {
-  double time;
+  double time;		// deadline
+  unsigned long order;	// sequence number, to break ties
   void (*cb)(void*);
   void* arg;
-  Timeout* next;
+  int index;		// position in timeout_heap
+  Timeout* next;	// hash chain, or next free Timeout
 };
-static Timeout* first_timeout, *free_timeout;
+static Timeout** timeout_heap;
+static int num_timeouts, alloc_timeouts;
+static Timeout** timeout_hash;
+static int num_timeout_hash;
+static Timeout* free_timeout;
+static unsigned long timeout_order;
+
+static Timeout* first_timeout() {
+  return num_timeouts ? timeout_heap[0] : 0;
+}
 
-#include <sys/time.h>
+static int timeout_before(const Timeout* a, const Timeout* b) {
+  if (a->time != b->time) return a->time < b->time;
+  return a->order < b->order;
+}
 
-// I avoid the overhead of getting the current time when we have no
-// timeouts by setting this flag instead of getting the time.
-// In this case calling elapse_timeouts() does nothing, but records
-// the current time, and the next call will actually elapse time.
-static char reset_clock = 1;
+static void timeout_place(Timeout* t, int i) {
+  timeout_heap[i] = t;
+  t->index = i;
+}
 
-static void elapse_timeouts() {
-  static struct timeval prevclock;
-  struct timeval newclock;
-  gettimeofday(&newclock, NULL);
-  double elapsed = newclock.tv_sec - prevclock.tv_sec +
-    (newclock.tv_usec - prevclock.tv_usec)/1000000.0;
-  prevclock.tv_sec = newclock.tv_sec;
-  prevclock.tv_usec = newclock.tv_usec;
-  if (reset_clock) {
-    reset_clock = 0;
-  } else if (elapsed > 0) {
-    for (Timeout* t = first_timeout; t; t = t->next) t->time -= elapsed;
+static void timeout_up(int i) {
+  Timeout* t = timeout_heap[i];
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!timeout_before(t, timeout_heap[parent])) break;
+    timeout_place(timeout_heap[parent], i);
+    i = parent;
+  }
+  timeout_place(t, i);
+}
+
+static void timeout_down(int i) {
+  Timeout* t = timeout_heap[i];
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= num_timeouts) break;
+    if (child + 1 < num_timeouts &&
+        timeout_before(timeout_heap[child + 1], timeout_heap[child])) child++;
+    if (!timeout_before(timeout_heap[child], t)) break;
+    timeout_place(timeout_heap[child], i);
+    i = child;
+  }
+  timeout_place(t, i);
+}
+
+static Timeout** timeout_bucket(void (*cb)(void*), void* arg) {
+  unsigned long h = (unsigned long)cb ^ ((unsigned long)arg * 31);
+  h ^= h >> 7;
+  return timeout_hash + (h & (num_timeout_hash - 1));
+}
+
+// Keep the hash table at least as large as the heap:
+static void timeout_rehash() {
+  if (num_timeout_hash >= alloc_timeouts) return;
+  int n = num_timeout_hash ? num_timeout_hash : 64;
+  while (n < alloc_timeouts) n *= 2;
+  free(timeout_hash);
+  timeout_hash = (Timeout**)calloc(n, sizeof(Timeout*));
+  num_timeout_hash = n;
+  for (int i = 0; i < num_timeouts; i++) {
+    Timeout* t = timeout_heap[i];
+    Timeout** b = timeout_bucket(t->cb, t->arg);
+    t->next = *b;
+    *b = t;
   }
 }
 
+static void timeout_unhash(Timeout* t) {
+  Timeout** p = timeout_bucket(t->cb, t->arg);
+  while (*p != t) p = &((*p)->next);
+  *p = t->next;
+}
+
+// Removes t from the heap and the hash table and frees it:
+static void timeout_remove(Timeout* t) {
+  timeout_unhash(t);
+  int i = t->index;
+  Timeout* last = timeout_heap[--num_timeouts];
+  if (last != t) {
+    timeout_place(last, i);
+    timeout_up(i);
+    timeout_down(last->index);
+  }
+  t->next = free_timeout;
+  free_timeout = t;
+}
+
+// The time the timeouts were last checked at. Timeouts are only
+// compared to the clock while there are any, the clock is not
+// read at all when there are none.
+static double timeout_now;
+
+static void elapse_timeouts() {
+  timeout_now = monotonic_clock();
+}
+
 // Continuously-adjusted error value, this is a number <= 0 for how late
 // we were at calling the last timeout. This appears to make repeat_timeout
 // very accurate even when processing takes a significant portion of the
@@ -294,21 +400,28 @@ void Fl::repeat_timeout(double time, Fl_Timeout_Handler cb, void *argp) {
   } else {
       t = new Timeout;
   }
-  t->time = time;
+  t->time = timeout_now + time;
+  t->order = timeout_order++;
   t->cb = cb;
   t->arg = argp;
-  // insert-sort the new timeout:
-  Timeout** p = &first_timeout;
-  while (*p && (*p)->time <= time) p = &((*p)->next);
-  t->next = *p;
-  *p = t;
+  if (num_timeouts >= alloc_timeouts) {
+    alloc_timeouts = alloc_timeouts ? 2 * alloc_timeouts : 64;
+    timeout_heap = (Timeout**)realloc(timeout_heap, alloc_timeouts * sizeof(Timeout*));
+    timeout_rehash();
+  }
+  Timeout** b = timeout_bucket(cb, argp);
+  t->next = *b;
+  *b = t;
+  timeout_place(t, num_timeouts++);
+  timeout_up(t->index);
 }
 
 /**
   Returns true if the timeout exists and has not been called yet.
 */
 int Fl::has_timeout(Fl_Timeout_Handler cb, void *argp) {
-  for (Timeout* t = first_timeout; t; t = t->next)
+  if (!num_timeouts) return 0;
+  for (Timeout* t = *timeout_bucket(cb, argp); t; t = t->next)
     if (t->cb == cb && t->arg == argp) return 1;
   return 0;
 }
@@ -321,20 +434,54 @@ int Fl::has_timeout(Fl_Timeout_Handler cb, void *argp) {
 	This may change in the future.
 */
 void Fl::remove_timeout(Fl_Timeout_Handler cb, void *argp) {
-  for (Timeout** p = &first_timeout; *p;) {
-    Timeout* t = *p;
-    if (t->cb == cb && (t->arg == argp || !argp)) {
-      *p = t->next;
-      t->next = free_timeout;
-      free_timeout = t;
-    } else {
-      p = &(t->next);
+  if (!num_timeouts) return;
+  if (argp) {
+    for (Timeout** p = timeout_bucket(cb, argp); *p;) {
+      Timeout* t = *p;
+      if (t->cb == cb && t->arg == argp) timeout_remove(t);
+      else p = &(t->next);
     }
+    return;
   }
+  // all timeouts of cb, whatever their argument is, are dropped from
+  // the heap in one pass, which is then rebuilt:
+  int n = 0;
+  for (int i = 0; i < num_timeouts; i++) {
+    Timeout* t = timeout_heap[i];
+    if (t->cb != cb) { timeout_place(t, n++); continue; }
+    timeout_unhash(t);
+    t->next = free_timeout;
+    free_timeout = t;
+  }
+  if (n == num_timeouts) return;
+  num_timeouts = n;
+  for (int i = n / 2; i--;) timeout_down(i);
 }
 
 #endif
 
+/**
+  Reports how late timeout callbacks were called.
+
+  Every call of a timeout callback is measured against the time it was
+  due, which also shows how much a callback rescheduling itself with
+  repeat_timeout() drifts. Only collected on X11.
+
+  \param[out] calls number of timeout callbacks called
+  \param[out] mean_late average lateness in seconds
+  \param[out] max_late greatest lateness in seconds
+  \param[in] reset if non-zero, the statistics are cleared afterwards
+*/
+void Fl::timeout_stats(unsigned &calls, double &mean_late, double &max_late, int reset) {
+  calls = timeout_calls;
+  mean_late = timeout_calls ? timeout_late_sum / timeout_calls : 0;
+  max_late = timeout_late_max;
+  if (reset) {
+    timeout_calls = 0;
+    timeout_late_sum = timeout_late_max = 0;
+  }
+}
+
 ////////////////////////////////////////////////////////////////
 // Checks are just stored in a list. They are called in the reverse
 // order that they were added (this may change in the future).
@@ -478,24 +625,23 @@ double Fl::wait(double time_to_wait) {
 
 #else
 
-  if (first_timeout) {
+  if (first_timeout()) {
     elapse_timeouts();
     Timeout *t;
-    while ((t = first_timeout)) {
-      if (t->time > 0) break;
-      // The first timeout in the array has expired.
-      missed_timeout_by = t->time;
-      // We must remove timeout from array before doing the callback:
+    while ((t = first_timeout())) {
+      if (t->time > timeout_now) break;
+      // The first timeout in the heap has expired.
+      missed_timeout_by = t->time - timeout_now;
+      timeout_calls++;
+      timeout_late_sum -= missed_timeout_by;
+      if (-missed_timeout_by > timeout_late_max) timeout_late_max = -missed_timeout_by;
+      // We must remove timeout from heap before doing the callback:
       void (*cb)(void*) = t->cb;
       void *argp = t->arg;
-      first_timeout = t->next;
-      t->next = free_timeout;
-      free_timeout = t;
+      timeout_remove(t);
       // Now it is safe for the callback to do add_timeout:
       cb(argp);
     }
-  } else {
-    reset_clock = 1; // we are not going to check the clock
   }
   run_checks();
 //  if (idle && !fl_ready()) {
@@ -508,8 +654,8 @@ double Fl::wait(double time_to_wait) {
     // the idle function may turn off idle, we can then wait:
     if (idle) time_to_wait = 0.0;
   }
-  if (first_timeout && first_timeout->time < time_to_wait)
-    time_to_wait = first_timeout->time;
+  if (first_timeout() && first_timeout()->time - timeout_now < time_to_wait)
+    time_to_wait = first_timeout()->time - timeout_now;
   if (time_to_wait <= 0.0) {
     // do flush second so that the results of events are visible:
     int ret = fl_wait(0.0);
@@ -520,6 +666,12 @@ double Fl::wait(double time_to_wait) {
     flush();
     if (idle && !in_idle) // 'idle' may have been set within flush()
       time_to_wait = 0.0;
+    // flush() may have deferred a window to its next frame:
+    if (first_timeout()) {
+      elapse_timeouts();
+      if (first_timeout()->time - timeout_now < time_to_wait)
+        time_to_wait = first_timeout()->time - timeout_now;
+    }
     return fl_wait(time_to_wait);
   }
 #endif
@@ -649,11 +801,9 @@ int Fl::check() {
 */
 int Fl::ready() {
 #if ! defined( WIN32 )  &&  ! defined(__APPLE__)
-  if (first_timeout) {
+  if (first_timeout()) {
     elapse_timeouts();
-    if (first_timeout->time <= 0) return 1;
-  } else {
-    reset_clock = 1;
+    if (first_timeout()->time <= timeout_now) return 1;
   }
 #endif
   return fl_ready();
@@ -729,6 +879,62 @@ void Fl::redraw() {
   for (Fl_X* i = Fl_X::first; i; i = i->next) i->w->redraw();
 }
 
+////////////////////////////////////////////////////////////////
+// Frame pacing:
+//
+// A window with a frame rate set is painted at most once per frame
+// interval. Damage arriving in between is left on the window (and
+// merged into its damage region as usual) and a timeout is scheduled
+// for the start of the next frame, which flushes everything at once.
+
+static void frame_timeout_cb(void *) {
+  // the window itself is not touched here, so it is harmless if it
+  // has been deleted since the timeout was added
+  Fl::damage(FL_DAMAGE_CHILD);
+}
+
+/**
+  Limits how often this window is painted.
+
+  When a frame rate is set, any number of redraw() calls and damage
+  arriving within one frame interval result in a single flush at the
+  start of the next frame, instead of one flush per pass through the
+  event loop. This caps the cost of windows showing rapidly changing
+  data, such as meters fed by another thread at a high rate.
+
+  Frames which could not be painted on time are counted, see
+  missed_frames().
+
+  \param[in] hz frames per second, or 0 (the default) to paint as soon
+             as possible
+*/
+void Fl_Window::frame_rate(double hz) {
+  frame_interval_ = hz > 0 ? 1.0 / hz : 0;
+  frame_pending_ = 0;
+  frame_missed_ = 0;
+}
+
+/** Returns the frame rate set with frame_rate(double), or 0 if unlimited. */
+double Fl_Window::frame_rate() const {
+  return frame_interval_ > 0 ? 1.0 / frame_interval_ : 0;
+}
+
+// Returns true if the damaged window wi may be painted now. Otherwise
+// makes sure it will be flushed when its next frame is due.
+static bool frame_due(Fl_Window *wi, double now, double interval, double last, double &pending) {
+  double next = last + interval;
+
+  if (!pending) pending = now;
+
+  // allow for the timer firing a little early
+  if (now >= next - interval * 0.1) return true;
+
+  if (!Fl::has_timeout(frame_timeout_cb, wi))
+    Fl::add_timeout(next - now, frame_timeout_cb, wi);
+
+  return false;
+}
+
 /**
   Causes all the windows that need it to be redrawn and graphics forced
   out through the pipes.
@@ -747,7 +953,26 @@ void Fl::flush() {
       if (i->wait_for_expose) {damage_ = 1; continue;}
       Fl_Window* wi = i->w;
       if (!wi->visible_r()) continue;
-      if (wi->damage()) {wi->make_current(); i->flush(); wi->clear_damage();}
+      if (wi->damage()) {
+        double now = 0;
+        if (wi->frame_interval_ > 0) {
+          now = monotonic_clock();
+          if (!frame_due(wi, now, wi->frame_interval_, wi->frame_last_, wi->frame_pending_))
+            continue; // keep the damage (and region) for the next frame
+        }
+        wi->make_current(); i->flush(); wi->clear_damage();
+        if (wi->frame_interval_ > 0) {
+          // count the frames which passed while damage was waiting, and
+          // those taken up by painting itself
+          double done = monotonic_clock();
+          double start = wi->frame_last_ + wi->frame_interval_;
+          if (wi->frame_pending_ > start) start = wi->frame_pending_;
+          if (now - start > 0) wi->frame_missed_ += (unsigned)((now - start) / wi->frame_interval_);
+          if (done - now > wi->frame_interval_) wi->frame_missed_ += (unsigned)((done - now) / wi->frame_interval_);
+          wi->frame_last_ = now;
+          wi->frame_pending_ = 0;
+        }
+      }
       // destroy damage regions for windows that don't use them:
       if ( i->region )
       {
@@ -1049,6 +1274,62 @@ static int send(int event, Fl_Widget* to, Fl_Window* window) {
   return ret;
 }
 
+extern int fl_shortcut_candidates(Fl_Widget**, int); // in fl_shortcut.cxx
+
+static Fl_Widget* outermost(Fl_Widget* w) {
+  while (w->parent()) w = w->parent();
+  return w;
+}
+
+// A registered widget that already refused the current FL_SHORTCUT,
+// skipped by the broadcast that follows (see Fl_Group::handle()).
+Fl_Widget* fl_shortcut_tried;
+
+// Send FL_SHORTCUT directly to the widget registered for the key if
+// it is the only one the broadcast in Fl::handle() could reach inside
+// the window \p top. The widget \p skip was tried already. Returns 1
+// if the widget took the key, 0 if it refused it, in which case it is
+// left in fl_shortcut_tried, and -1 if there is no such widget or
+// several, so that the broadcast decides in its usual order.
+static int send_registered_shortcut(Fl_Widget* top, Fl_Widget* skip) {
+  Fl_Widget* c[32];
+  int n = fl_shortcut_candidates(c, 32);
+  Fl_Widget* to = 0;
+  for (int i = 0; i < n; i++) {
+    if (!c[i]->visible_r() || !c[i]->active_r()) continue;
+    if (outermost(c[i]) != top) continue;
+    if (to) return -1;
+    to = c[i];
+  }
+  if (!to || to == skip) return -1;
+  if (send(FL_SHORTCUT, to, to->window())) return 1;
+  fl_shortcut_tried = to;
+  return 0;
+}
+
+// Offer FL_SHORTCUT to \p wi and its parents. The widget under the
+// mouse comes first, then a widget registered for the key, and only
+// if that refuses it the broadcast without it. A registered widget
+// thus wins over unregistered ones elsewhere in the window, such as
+// an Fl_Return_Button taking the Enter key.
+static int send_shortcut(Fl_Widget* wi) {
+  Fl_Widget* skip = 0;
+  if (wi == Fl::belowmouse()) {
+    if (send(FL_SHORTCUT, wi, wi->window())) return 1;
+    skip = wi;
+  }
+  if (send_registered_shortcut(outermost(wi), skip) > 0) return 1;
+  int ret = 0;
+  for (wi = skip ? wi->parent() : wi; wi; wi = wi->parent()) {
+    if (wi != fl_shortcut_tried && send(FL_SHORTCUT, wi, wi->window())) {
+      ret = 1;
+      break;
+    }
+  }
+  fl_shortcut_tried = 0;
+  return ret;
+}
+
 
 /**
  \brief Set a new event dispatch function.
@@ -1295,14 +1576,14 @@ int Fl::handle_(int e, Fl_Window* window)
     if (!wi) {
       wi = modal();
       if (!wi) wi = window;
-    } else if (wi->window() != first_window()) {
-      if (send(FL_SHORTCUT, first_window(), first_window())) return 1;
     }
 
-    for (; wi; wi = wi->parent()) {
-      if (send(FL_SHORTCUT, wi, wi->window())) return 1;
+    if (wi && wi == belowmouse() && wi->window() != first_window()) {
+      if (send(FL_SHORTCUT, first_window(), first_window())) return 1;
     }
 
+    if (wi && send_shortcut(wi)) return 1;
+
     // try using add_handle() functions:
     if (send_handlers(FL_SHORTCUT)) return 1;
 
@@ -1574,6 +1855,7 @@ void Fl_Widget::redraw() {
 
 void Fl_Widget::redraw_label() {
   if (window()) {
+    Fl_Group::uncache(this);
     if (box() == FL_NO_BOX) {
       // Widgets with the FL_NO_BOX boxtype need a parent to
       // redraw, since it is responsible for redrawing the
@@ -42,7 +42,10 @@
 // so that the number of items in the browser and size of those items
 // is unlimited. The only problem is that the old browser used an
 // index number to identify a line, and it is slow to convert from/to
-// a pointer. I use a cache of the last match to try to speed this up.
+// a pointer. To make that fast the lines are also kept in chunks of
+// up to BLINE_CHUNK pointers, with Fenwick trees over the number of
+// lines and the height of each chunk (see FL_BLINE_INDEX), so both
+// conversions take O(log n) steps plus a scan of one chunk.
 
 // Also added the ability to "hide" a line. This sets its height to
 // zero, so the Fl_Browser_ cannot pick it.
@@ -55,16 +58,270 @@
 //       Changes to FL_BLINE *must* be reflected in Fl_File_Chooser.cxx as well.
 //       This hack in Fl_File_Chooser should be solved.
 //
+struct FL_BLINE_CHUNK;
+
 struct FL_BLINE {	// data is in a linked list of these
   FL_BLINE* prev;
   FL_BLINE* next;
   void* data;
   Fl_Image* icon;
+  FL_BLINE_CHUNK* chunk;	// chunk of the index holding this line
+  int height;		// height counted in full_height()
+  int width;		// item_width() when last drawn, or -1
   short length;		// sizeof(txt)-1, may be longer than string
   char flags;		// selected, displayed
   char txt[1];		// start of allocated array
 };
 
+#define BLINE_CHUNK 128
+
+struct FL_BLINE_CHUNK {
+  int n;		// number of lines
+  int height;		// sum of the line heights
+  int width;		// widest measured line
+  int index;		// position in FL_BLINE_INDEX::chunks
+  FL_BLINE* line[BLINE_CHUNK];
+};
+
+// Line numbers and heights of the lines of an Fl_Browser
+struct FL_BLINE_INDEX {
+  FL_BLINE_CHUNK** chunks;
+  int nchunks, achunks;
+  int *flines, *fheight;	// Fenwick trees over the chunk totals
+  int *fwidth;			// max segment tree over the chunk widths
+  int top;			// highest power of two <= nchunks
+  int lines, height;		// totals
+  Fl_Font wfont;		// font and size the widths were measured with
+  Fl_Fontsize wsize;
+  Fl_Font hfont;		// font and size the heights were measured with
+  Fl_Fontsize hsize;
+
+  FL_BLINE_INDEX() {
+    chunks = 0; nchunks = achunks = 0;
+    flines = fheight = fwidth = 0; top = 0;
+    lines = height = 0;
+    wfont = 0; wsize = 0;
+    hfont = 0; hsize = 0;
+  }
+  ~FL_BLINE_INDEX() {
+    for (int i = 0; i < nchunks; i++) free(chunks[i]);
+    free(chunks); free(flines); free(fheight); free(fwidth);
+  }
+
+  FL_BLINE_CHUNK* add_chunk(int at) {
+    if (nchunks == achunks) {
+      achunks = achunks ? 2*achunks : 16;
+      chunks = (FL_BLINE_CHUNK**)realloc(chunks, achunks*sizeof(FL_BLINE_CHUNK*));
+    }
+    memmove(chunks+at+1, chunks+at, (nchunks-at)*sizeof(FL_BLINE_CHUNK*));
+    nchunks++;
+    FL_BLINE_CHUNK* c = (FL_BLINE_CHUNK*)calloc(1, sizeof(FL_BLINE_CHUNK));
+    chunks[at] = c;
+    return c;
+  }
+
+  // renumber the chunks and build the Fenwick trees in linear time
+  void rebuild() {
+    int i;
+    flines = (int*)realloc(flines, (nchunks+1)*sizeof(int));
+    fheight = (int*)realloc(fheight, (nchunks+1)*sizeof(int));
+    flines[0] = fheight[0] = 0;
+    for (i = 1; i <= nchunks; i++) {
+      chunks[i-1]->index = i-1;
+      flines[i] = chunks[i-1]->n;
+      fheight[i] = chunks[i-1]->height;
+    }
+    for (i = 1; i <= nchunks; i++) {
+      int j = i + (i & -i);
+      if (j <= nchunks) {flines[j] += flines[i]; fheight[j] += fheight[i];}
+    }
+    for (top = 1; top*2 <= nchunks; top *= 2) ;
+    if (!nchunks) top = 0;
+    fwidth = (int*)realloc(fwidth, (2*nchunks+1)*sizeof(int));
+    fwidth[1] = 0;
+    for (i = 0; i < nchunks; i++) fwidth[nchunks+i] = chunks[i]->width;
+    for (i = nchunks-1; i > 0; i--)
+      fwidth[i] = fwidth[2*i] > fwidth[2*i+1] ? fwidth[2*i] : fwidth[2*i+1];
+  }
+
+  // widest measured line of all
+  int width() const {return nchunks ? fwidth[1] : 0;}
+
+  // recompute the width of chunk c from its lines, without measuring any
+  void chunk_width(FL_BLINE_CHUNK* c) {
+    int w = 0;
+    for (int o = 0; o < c->n; o++)
+      if (c->line[o]->width > w) w = c->line[o]->width;
+    if (w == c->width) return;
+    c->width = w;
+    int i = c->index + nchunks;
+    for (fwidth[i] = w, i >>= 1; i > 0; i >>= 1)
+      fwidth[i] = fwidth[2*i] > fwidth[2*i+1] ? fwidth[2*i] : fwidth[2*i+1];
+  }
+
+  void set_width(FL_BLINE* l, int w) {
+    int old = l->width;
+    l->width = w;
+    if (w > l->chunk->width || (old == l->chunk->width && w < old))
+      chunk_width(l->chunk);
+  }
+
+  // forget all widths, e.g. after the font changed
+  void forget_widths() {
+    for (int i = 0; i < nchunks; i++) {
+      FL_BLINE_CHUNK* c = chunks[i];
+      for (int o = 0; o < c->n; o++) c->line[o]->width = -1;
+      c->width = 0;
+    }
+    rebuild();
+  }
+
+  void fenwick_add(int c, int dlines, int dheight) {
+    for (int i = c+1; i <= nchunks; i += i & -i) {
+      flines[i] += dlines;
+      fheight[i] += dheight;
+    }
+  }
+
+  // sum of the first c chunks
+  int fenwick_sum(const int* f, int c) const {
+    int sum = 0;
+    for (int i = c; i > 0; i -= i & -i) sum += f[i];
+    return sum;
+  }
+
+  // chunk holding line (0 based) and the line's offset in it
+  FL_BLINE_CHUNK* find(int line, int* offset) const {
+    int idx = 0, sum = 0;
+    for (int step = top; step; step >>= 1) {
+      if (idx+step <= nchunks && sum + flines[idx+step] <= line) {
+        idx += step;
+        sum += flines[idx];
+      }
+    }
+    *offset = line - sum;
+    return chunks[idx];
+  }
+
+  static int offset_of(const FL_BLINE* l) {
+    const FL_BLINE_CHUNK* c = l->chunk;
+    int o = 0;
+    while (c->line[o] != l) o++;
+    return o;
+  }
+
+  FL_BLINE* at(int line) const {	// 1 based
+    if (line < 1 || line > lines) return 0;
+    int o;
+    FL_BLINE_CHUNK* c = find(line-1, &o);
+    return c->line[o];
+  }
+
+  int lineno(const FL_BLINE* l) const {	// 1 based
+    return fenwick_sum(flines, l->chunk->index) + offset_of(l) + 1;
+  }
+
+  // height of all lines above line (1 based)
+  int height_before(int line) const {
+    if (line <= 1) return 0;
+    if (line > lines) return height;
+    int o;
+    FL_BLINE_CHUNK* c = find(line-1, &o);
+    int h = fenwick_sum(fheight, c->index);
+    for (int i = 0; i < o; i++) h += c->line[i]->height;
+    return h;
+  }
+
+  // insert l above line (1 based), or at the end if line > lines
+  void insert(int line, FL_BLINE* l) {
+    FL_BLINE_CHUNK* c;
+    int o;
+    if (line > lines || !lines) {
+      c = nchunks ? chunks[nchunks-1] : 0;
+      if (!c || c->n == BLINE_CHUNK) {c = add_chunk(nchunks); rebuild();}
+      o = c->n;
+    } else {
+      if (line < 1) line = 1;
+      c = find(line-1, &o);
+      if (c->n == BLINE_CHUNK) {	// full? split it in two
+        FL_BLINE_CHUNK* d = add_chunk(c->index+1);
+        d->n = BLINE_CHUNK/2;
+        memcpy(d->line, c->line+BLINE_CHUNK/2, d->n*sizeof(FL_BLINE*));
+        c->n -= d->n;
+        for (int i = 0; i < d->n; i++) {
+          d->line[i]->chunk = d;
+          d->height += d->line[i]->height;
+        }
+        c->height -= d->height;
+        rebuild();
+        chunk_width(c);
+        chunk_width(d);
+        c = find(line-1, &o);
+      }
+    }
+    memmove(c->line+o+1, c->line+o, (c->n-o)*sizeof(FL_BLINE*));
+    c->line[o] = l;
+    c->n++;
+    c->height += l->height;
+    l->chunk = c;
+    lines++;
+    height += l->height;
+    fenwick_add(c->index, 1, l->height);
+  }
+
+  void remove(FL_BLINE* l) {
+    FL_BLINE_CHUNK* c = l->chunk;
+    int o = offset_of(l);
+    memmove(c->line+o, c->line+o+1, (c->n-o-1)*sizeof(FL_BLINE*));
+    c->n--;
+    c->height -= l->height;
+    lines--;
+    height -= l->height;
+    if (!c->n) {
+      int at = c->index;
+      free(c);
+      nchunks--;
+      memmove(chunks+at, chunks+at+1, (nchunks-at)*sizeof(FL_BLINE_CHUNK*));
+      rebuild();
+    } else {
+      fenwick_add(c->index, -1, -l->height);
+      if (l->width == c->width) chunk_width(c);
+    }
+  }
+
+  void set_height(FL_BLINE* l, int h) {
+    int d = h - l->height;
+    if (!d) return;
+    l->height = h;
+    l->chunk->height += d;
+    height += d;
+    fenwick_add(l->chunk->index, 0, d);
+  }
+
+  // n takes the place of l (e.g. after a realloc of l)
+  void replace(FL_BLINE* l, FL_BLINE* n) {
+    n->chunk = l->chunk;
+    n->height = l->height;
+    n->width = l->width;
+    n->chunk->line[offset_of(l)] = n;
+  }
+
+  void swap(FL_BLINE* a, FL_BLINE* b) {
+    FL_BLINE_CHUNK* ca = a->chunk;
+    FL_BLINE_CHUNK* cb = b->chunk;
+    int oa = offset_of(a), ob = offset_of(b);
+    ca->line[oa] = b; b->chunk = ca;
+    cb->line[ob] = a; a->chunk = cb;
+    if (ca != cb) {
+      int d = b->height - a->height;
+      ca->height += d; fenwick_add(ca->index, 0, d);
+      cb->height -= d; fenwick_add(cb->index, 0, -d);
+      chunk_width(ca);
+      chunk_width(cb);
+    }
+  }
+};
+
 /**
   Returns the very first item in the list.
   Example of use:
@@ -141,13 +398,10 @@ const char *Fl_Browser::item_text(void *item) const {
 /**
   Returns the item for specified \p line.
 
-  Note: This call is slow. It's fine for e.g. responding to user
-  clicks, but slow if called often, such as in a tight sorting loop.
-  Finding an item 'by line' involves a linear lookup on the internal
-  linked list. The performance hit can be significant if the browser's
-  contents is large, and the method is called often (e.g. during a sort).
-  If you're writing a subclass, use the protected methods item_first(),
-  item_next(), etc. to access the internal linked list more efficiently.
+  Finding an item 'by line' takes O(log n) steps, where n is the
+  number of lines. Walking the list with the protected methods
+  item_first(), item_next(), etc. is still faster when every item
+  is visited, e.g. in a subclass.
 
   \param[in] line The line number of the item to return. (1 based)
   \retval item that was found.
@@ -155,20 +409,7 @@ const char *Fl_Browser::item_text(void *item) const {
   \see item_at(), find_line(), lineno()
 */
 FL_BLINE* Fl_Browser::find_line(int line) const {
-  int n; FL_BLINE* l;
-  if (line == cacheline) return cache;
-  if (cacheline && line > (cacheline/2) && line < ((cacheline+lines)/2)) {
-    n = cacheline; l = cache;
-  } else if (line <= (lines/2)) {
-    n = 1; l = first;
-  } else {
-    n = lines; l = last;
-  }
-  for (; n < line && l; n++) l = l->next;
-  for (; n > line && l; n--) l = l->prev;
-  ((Fl_Browser*)this)->cacheline = line;
-  ((Fl_Browser*)this)->cache = l;
-  return l;
+  return index_ ? index_->at(line) : 0;
 }
 
 /**
@@ -180,29 +421,8 @@ FL_BLINE* Fl_Browser::find_line(int line) const {
 */
 int Fl_Browser::lineno(void *item) const {
   FL_BLINE* l = (FL_BLINE*)item;
-  if (!l) return 0;
-  if (l == cache) return cacheline;
-  if (l == first) return 1;
-  if (l == last) return lines;
-  if (!cache) {
-    ((Fl_Browser*)this)->cache = first;
-    ((Fl_Browser*)this)->cacheline = 1;
-  }
-  // assume it is near cache, search both directions:
-  FL_BLINE* b = cache->prev;
-  int bnum = cacheline-1;
-  FL_BLINE* f = cache->next;
-  int fnum = cacheline+1;
-  int n = 0;
-  for (;;) {
-    if (b == l) {n = bnum; break;}
-    if (f == l) {n = fnum; break;}
-    if (b) {b = b->prev; bnum--;}
-    if (f) {f = f->next; fnum++;}
-  }
-  ((Fl_Browser*)this)->cache = l;
-  ((Fl_Browser*)this)->cacheline = n;
-  return n;
+  if (!l || !index_) return 0;
+  return index_->lineno(l);
 }
 
 /**
@@ -217,10 +437,8 @@ FL_BLINE* Fl_Browser::_remove(int line) {
   FL_BLINE* ttt = find_line(line);
   deleting(ttt);
 
-  cacheline = line-1;
-  cache = ttt->prev;
   lines--;
-  full_height_ -= item_height(ttt);
+  index_->remove(ttt);
   if (ttt->prev) ttt->prev->next = ttt->next;
   else first = ttt->next;
   if (ttt->next) ttt->next->prev = ttt->prev;
@@ -273,10 +491,15 @@ void Fl_Browser::insert(int line, FL_BLINE* item) {
     item->prev->next = item;
     n->prev = item;
   }
-  cacheline = line;
-  cache = item;
+  if (!index_) {
+    index_ = new FL_BLINE_INDEX;
+    index_->hfont = textfont();
+    index_->hsize = textsize();
+  }
+  item->height = item_height(item);
+  item->width = -1;			// measured when drawn
+  index_->insert(line, item);
   lines++;
-  full_height_ += item_height(item);
   redraw_line(item);
 }
 
@@ -333,7 +556,7 @@ void Fl_Browser::text(int line, const char* newtext) {
   if (l > t->length) {
     FL_BLINE* n = (FL_BLINE*)malloc(sizeof(FL_BLINE)+l);
     replacing(t, n);
-    cache = n;
+    index_->replace(t, n);
     n->data = t->data;
     n->icon = t->icon;
     n->length = (short)l;
@@ -346,6 +569,8 @@ void Fl_Browser::text(int line, const char* newtext) {
     t = n;
   }
   strcpy(t->txt, newtext);
+  index_->set_height(t, item_height(t));
+  index_->set_width(t, -1);
   redraw_line(t);
 }
 
@@ -492,7 +717,87 @@ int Fl_Browser::item_width(void *item) const {
        incr_height(), full_height()
 */
 int Fl_Browser::full_height() const {
-  return full_height_;
+  if (!index_) return 0;
+  check_heights();
+  return index_->height;
+}
+
+/**
+  Measures the height of every line again if textfont() or textsize()
+  changed since the heights were taken.
+  \see full_height()
+*/
+void Fl_Browser::check_heights() const {
+  if (!index_ || (index_->hfont == textfont() && index_->hsize == textsize()))
+    return;
+  index_->hfont = textfont();
+  index_->hsize = textsize();
+  for (FL_BLINE* l = first; l; l = l->next)
+    index_->set_height(l, item_height(l));
+}
+
+/**
+  The width of the widest line that has been drawn, in pixels.
+
+  Each line remembers its width from when it was last drawn, and the
+  widest is kept track of for chunks of lines, so changing or removing
+  the widest line does not measure any other line again.
+
+  \returns The width of the widest line that has been drawn, in pixels.
+  \see full_height(), note_width()
+*/
+int Fl_Browser::full_width() const {
+  if (!index_) return 0;
+  if (index_->wfont != textfont() || index_->wsize != textsize()) return 0;
+  return index_->width();
+}
+
+/**
+  Measures \p item with item_width() when it is drawn, unless its
+  width is already known.
+  \param[in] item The item that was drawn.
+  \see full_width()
+*/
+void Fl_Browser::note_width(void *item) {
+  FL_BLINE* l = (FL_BLINE*)item;
+  if (index_->wfont != textfont() || index_->wsize != textsize()) {
+    index_->forget_widths();		// all widths depend on these
+    index_->wfont = textfont();
+    index_->wsize = textsize();
+  }
+  if (l->width < 0) index_->set_width(l, item_width(l));
+}
+
+/**
+  Sets the column separator to c.
+  This will only have an effect if you also set column_widths().
+  The default is '\\t' (tab).
+  \see column_char(), column_widths()
+*/
+void Fl_Browser::column_char(char c) {
+  if (c == column_char_) return;
+  column_char_ = c;
+  columns_changed();
+}
+
+/**
+  Sets the current array to \p arr.  Make sure the last entry is zero.
+  \see column_char(), column_widths()
+*/
+void Fl_Browser::column_widths(const int* arr) {
+  column_widths_ = arr;
+  columns_changed();
+}
+
+/**
+  Measures every line again after the columns changed, since the
+  columns decide both the width and the height of a line.
+*/
+void Fl_Browser::columns_changed() {
+  if (!index_) return;
+  index_->forget_widths();
+  for (FL_BLINE* l = first; l; l = l->next)
+    index_->set_height(l, item_height(l));
 }
 
 /**
@@ -615,11 +920,10 @@ Fl_Browser::Fl_Browser(int X, int Y, int W, int H, const char *L)
 : Fl_Browser_(X, Y, W, H, L) {
   column_widths_ = no_columns;
   lines = 0;
-  full_height_ = 0;
-  cacheline = 0;
+  index_ = 0;
   format_char_ = '@';
   column_char_ = '\t';
-  first = last = cache = 0;
+  first = last = 0;
 }
 
 /**
@@ -631,13 +935,11 @@ Fl_Browser::Fl_Browser(int X, int Y, int W, int H, const char *L)
 void Fl_Browser::lineposition(int line, Fl_Line_Position pos) {
   if (line<1) line = 1;
   if (line>lines) line = lines;
-  int p = 0;
+  check_heights();
+  int p = index_ ? index_->height_before(line) : 0;
 
-  FL_BLINE* l;
-  for (l=first; l && line>1; l = l->next) {
-    line--; p += item_height(l);
-  }
-  if (l && (pos == BOTTOM)) p += item_height (l);
+  FL_BLINE* l = find_line(line);
+  if (l && (pos == BOTTOM)) p += l->height;
 
   int final = p, X, Y, W, H;
   bbox(X, Y, W, H);
@@ -671,7 +973,8 @@ void Fl_Browser::clear() {
     free(l);
     l = n;
   }
-  full_height_ = 0;
+  delete index_;
+  index_ = 0;
   first = 0;
   last = 0;
   lines = 0;
@@ -756,7 +1059,7 @@ void Fl_Browser::show(int line) {
   FL_BLINE* t = find_line(line);
   if (t->flags & NOTDISPLAYED) {
     t->flags &= ~NOTDISPLAYED;
-    full_height_ += item_height(t);
+    index_->set_height(t, item_height(t));
     if (Fl_Browser_::displayed(t)) redraw();
   }
 }
@@ -773,8 +1076,8 @@ void Fl_Browser::show(int line) {
 void Fl_Browser::hide(int line) {
   FL_BLINE* t = find_line(line);
   if (!(t->flags & NOTDISPLAYED)) {
-    full_height_ -= item_height(t);
     t->flags |= NOTDISPLAYED;
+    index_->set_height(t, item_height(t));
     if (Fl_Browser_::displayed(t)) redraw();
   }
 }
@@ -850,9 +1153,7 @@ void Fl_Browser::swap(FL_BLINE *a, FL_BLINE *b) {
      if ( bprev ) bprev->next = a; else first = a;
      a->next = bnext;
   }
-  // Disable cache -- we played around with positions
-  cacheline = 0;
-  cache = 0;
+  index_->swap(a, b);
 }
 
 /**
@@ -882,16 +1183,12 @@ void Fl_Browser::icon(int line, Fl_Image* icon) {
 
   FL_BLINE* bl = find_line(line);
 
-  int old_h = bl->icon ? bl->icon->h()+2 : 0;	// init with *old* icon height
-  bl->icon = 0;					// remove icon, if any
-  int th = item_height(bl);			// height of text only
-  int new_h = icon ? icon->h()+2 : 0;		// init with *new* icon height
-  if (th > old_h) old_h = th;
-  if (th > new_h) new_h = th;
-  int dh = new_h - old_h;
-  full_height_ += dh;				// do this *always*
-
+  int old_h = bl->height;			// height with *old* icon
   bl->icon = icon;				// set new icon
+  index_->set_height(bl, item_height(bl));	// do this *always*
+  index_->set_width(bl, -1);
+  int dh = bl->height - old_h;
+
   if (dh>0) {
     redraw();					// icon larger than item? must redraw widget
   } else {
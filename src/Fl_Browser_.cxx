@@ -420,8 +420,7 @@ J1:
 	draw_box(FL_BORDER_FRAME, X, yy+Y, W, hh, color());
 	draw_focus(FL_NO_BOX, X, yy+Y, W+1, hh+1);
       }
-      int ww = item_width(l);
-      if (ww > max_width) {max_width = ww; max_width_item = l;}
+      note_width(l);
     }
     yy += hh;
   }
@@ -1073,6 +1072,23 @@ int Fl_Browser_::full_height() const {
   return t;
 }
 
+/**
+  This method is called by draw() for every item it draws, to keep
+  track of the width of the list.
+  The default implementation measures the item with item_width() and
+  remembers the widest item seen so far.
+  A subclass that keeps the widths of its items can provide this
+  method and full_width(), so that items are not measured again every
+  time they are drawn and full_width() does not shrink to zero when
+  the widest item is deleted.
+  \param[in] item The item that was drawn.
+  \see full_width(), item_width()
+*/
+void Fl_Browser_::note_width(void *item) {
+  int ww = item_width(item);
+  if (ww > max_width) {max_width = ww; max_width_item = item;}
+}
+
 /**
   This method may be provided by the subclass to indicate the full width
   of the item list, in pixels. 
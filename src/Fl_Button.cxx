@@ -30,6 +30,9 @@
 #include <FL/Fl_Group.H>
 #include <FL/Fl_Window.H>
 
+extern void fl_shortcut_register(Fl_Widget*, int);	// in fl_shortcut.cxx
+extern void fl_shortcut_register_label(Fl_Widget*, int);
+
 
 Fl_Widget_Tracker *Fl_Button::key_release_tracker = 0;
 
@@ -211,6 +214,12 @@ Fl_Button::Fl_Button(int X, int Y, int W, int H, const char *L)
   value_ = oldval = 0;
   shortcut_ = 0;
   set_flag(SHORTCUT_LABEL);
+  fl_shortcut_register_label(this, 1);
+}
+
+void Fl_Button::shortcut(int s) {
+  shortcut_ = s;
+  fl_shortcut_register(this, s);
 }
 
 //
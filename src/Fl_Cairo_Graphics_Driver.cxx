@@ -27,9 +27,11 @@
  * calls to the base Xlib and Cairo routines can be mixed with the
  * expected results.
  * 
- * Fonts are still rendered using XFT. And since the FLTK image
- * drawing implementation already uses XRender, there would seem to be
- * little advantage to using Cairo for that either.
+ * Text is drawn with cairo_show_glyphs using the fonts XFT
+ * selects, so that labels are drawn in the same Cairo context as
+ * everything else. Rotated text still goes through XFT, and the Cairo
+ * text path can be turned off with the new fl_set_cairo_text()
+ * function.
  *
  * Alpha values can be encoded into Fl_Color values by using the new
  * fl_color_add_alpha function--with the caveat that 100% transparency
@@ -313,6 +315,28 @@ void fl_set_antialias ( int v )
 }
 
 
+static int cairo_text = 1;
+
+void fl_set_cairo_text ( int v )
+{
+    cairo_text = v;
+}
+
+extern int fl_cairo_draw_text ( cairo_t *cr, Fl_Font_Descriptor *desc, const char *str, int n, int x, int y );
+
+void Fl_Cairo_Graphics_Driver::draw ( const char *str, int n, int x, int y )
+{
+    cairo_t *cr = Fl::cairo_cc();
+
+    if ( ! font_descriptor() )
+        font( FL_HELVETICA, FL_NORMAL_SIZE );
+
+    if ( cairo_text && cr && fl_cairo_draw_text( cr, font_descriptor(), str, n, x, y ) )
+        return;
+
+    Fl_Xlib_Graphics_Driver::draw( str, n, x, y );
+}
+
 void Fl_Cairo_Graphics_Driver::color ( Fl_Color c, uchar a )
 {
     uchar r,g,b;
@@ -885,6 +909,103 @@ static int start(Fl_RGB_Image *img, int XP, int YP, int WP, int HP, int w, int h
   return 0;
 }
 
+/* Convert the pixels of /img/ into a premultiplied ARGB32 (or RGB24
+ * for opaque images) surface compatible with /target/. The result is
+ * cached on the image and is only rebuilt after uncache() has been
+ * called (which color_average() and desaturate() do). */
+static cairo_surface_t *
+create_image_surface ( Fl_RGB_Image *img, cairo_surface_t *target )
+{
+    const int w = img->w();
+    const int h = img->h();
+    const int d = img->d();
+    const int ld = img->ld() ? img->ld() : w * d;
+
+    const bool has_alpha = d == 2 || d == 4;
+
+    cairo_format_t fmt = has_alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24;
+
+    cairo_surface_t *image = cairo_image_surface_create( fmt, w, h );
+
+    if ( cairo_surface_status( image ) != CAIRO_STATUS_SUCCESS )
+    {
+        cairo_surface_destroy( image );
+        return 0;
+    }
+
+    cairo_surface_flush( image );
+
+    unsigned char *dst = cairo_image_surface_get_data( image );
+    const int stride = cairo_image_surface_get_stride( image );
+
+    for ( int y = 0; y < h; ++y )
+    {
+        const uchar *s = img->array + y * ld;
+        unsigned int *p = (unsigned int*)( dst + y * stride );
+
+        for ( int x = 0; x < w; ++x, s += d )
+        {
+            unsigned int r, g, b, a = 255;
+
+            switch ( d )
+            {
+                case 1:
+                    r = g = b = s[0];
+                    break;
+                case 2:
+                    r = g = b = s[0];
+                    a = s[1];
+                    break;
+                case 3:
+                    r = s[0]; g = s[1]; b = s[2];
+                    break;
+                default:
+                    r = s[0]; g = s[1]; b = s[2];
+                    a = s[3];
+                    break;
+            }
+
+            if ( a != 255 )
+            {
+                /* cairo wants premultiplied alpha */
+                r = ( r * a + 127 ) / 255;
+                g = ( g * a + 127 ) / 255;
+                b = ( b * a + 127 ) / 255;
+            }
+
+            *p++ = ( a << 24 ) | ( r << 16 ) | ( g << 8 ) | b;
+        }
+    }
+
+    cairo_surface_mark_dirty( image );
+
+    if ( ! target )
+        return image;
+
+    /* upload the pixels once to a surface of the same kind as the
+     * target (a server side pixmap for xlib) so that subsequent draws
+     * are a plain composite. */
+    cairo_surface_t *cs = cairo_surface_create_similar( target,
+                                                        has_alpha ? CAIRO_CONTENT_COLOR_ALPHA : CAIRO_CONTENT_COLOR,
+                                                        w, h );
+
+    if ( cairo_surface_status( cs ) != CAIRO_STATUS_SUCCESS )
+    {
+        cairo_surface_destroy( cs );
+        return image;
+    }
+
+    cairo_t *cr = cairo_create( cs );
+    cairo_set_operator( cr, CAIRO_OPERATOR_SOURCE );
+    cairo_set_source_surface( cr, image, 0, 0 );
+    cairo_paint( cr );
+    cairo_destroy( cr );
+
+    cairo_surface_destroy( image );
+
+    return cs;
+}
+
 void
 Fl_Cairo_Graphics_Driver::draw(Fl_RGB_Image *img, int XP, int YP, int WP, int HP, int cx, int cy)
 {
@@ -900,56 +1021,26 @@ Fl_Cairo_Graphics_Driver::draw(Fl_RGB_Image *img, int XP, int YP, int WP, int HP
       return;
   }
 
-  /* if (!img->id_) { */
-  /*   img->id_ = fl_create_offscreen(img->w(), img->h()); */
-  /*   if ((img->d() == 2 || img->d() == 4) ) { */
-  /*     fl_begin_offscreen((Fl_Offscreen)img->id_); */
-  /*     fl_draw_image(img->array, 0, 0, img->w(), img->h(), img->d()|FL_IMAGE_WITH_ALPHA, img->ld()); */
-  /*     fl_end_offscreen(); */
-  /*   } */
-  /* } */
-  
   cairo_t *cr = Fl::cairo_cc();
 
-  cairo_format_t fmt = CAIRO_FORMAT_ARGB32;
-
-  switch (img->d() )
-  {
-      case 4:
-          fmt = CAIRO_FORMAT_ARGB32;
-          break;
-      case 3:
-          fmt = CAIRO_FORMAT_RGB24;
-          break;
-      case 1:
-          fmt = CAIRO_FORMAT_A8;
-          break;
-  }
-
-  /* cairo_save( cr ); */
-
-  /* cairo_reset_clip( cr ); */
-
-  cairo_surface_t *image = cairo_image_surface_create_for_data( (unsigned char *)img->array, fmt, img->w(), img->h( ), 
-                                                                cairo_format_stride_for_width( fmt, img->w() ) );
-
-  /* cairo_surface_t *image = cairo_image_surface_create_for_data( (unsigned char *)img->array, fmt, img->w(), img->h(), img->ld() ); */
-
+  if ( ! cr )
+      return;
 
-  /* cairo_patter_t *pat = cairo_surface_pattern( image ); */
+  if ( ! img->surface_ )
+      img->surface_ = create_image_surface( img, cairo_get_target( cr ) );
 
-  /* cairo_matrix_t matr; */
+  if ( ! img->surface_ )
+      return;
 
-  /* cairo_matrix_scale( &matr,   */
+  /* preserve the current color */
+  cairo_pattern_t *old = cairo_pattern_reference( cairo_get_source( cr ) );
 
-  cairo_set_source_surface( cr, image, X - cx, Y - cy );
+  cairo_set_source_surface( cr, (cairo_surface_t*)img->surface_, X - cx, Y - cy );
 
   cairo_rectangle( cr, X, Y, W, H );
   
   cairo_fill(cr);
 
-  cairo_surface_destroy( image );
-
-  /* cairo_restore( cr ); */
+  cairo_set_source( cr, old );
+  cairo_pattern_destroy( old );
 }
-
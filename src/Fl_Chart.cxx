@@ -29,8 +29,11 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Chart.H>
 #include <FL/fl_draw.H>
+#include <FL/Fl_Device.H>
+#include <FL/Fl_Cairo.H>
 #include "flstring.h"
 #include <stdlib.h>
+#include <float.h>
 
 #define ARCINC	(2.0*M_PI/360.0)
 
@@ -230,8 +233,247 @@ static void draw_piechart(int x,int y,int w,int h,
     }
 }
 
+/* Streaming mode */
+
+// Values of a chart in streaming mode, see Fl_Chart::stream(int)
+struct Fl_Chart_Stream {
+  float *val;			// the last cap values
+  float *lo[32], *hi[32];	// minimum and maximum of blocks of 2^k values
+  int cap, levels;		// cap = 2^levels
+  unsigned long total;		// number of values added
+  // plot of the columns j0..jr drawn last:
+  cairo_surface_t *surface;
+  int w, h;
+  unsigned long j0, jr;
+  double min, max;
+  uchar type;
+  Fl_Color color;
+};
+
+static void stream_free(Fl_Chart_Stream *s) {
+  free(s->val);
+  for (int k = 1; k <= s->levels; k++) {
+    free(s->lo[k]);
+    free(s->hi[k]);
+  }
+  if (s->surface) cairo_surface_destroy(s->surface);
+  delete s;
+}
+
+static void stream_add(Fl_Chart_Stream *s, float v) {
+  unsigned long i = s->total++;
+  s->val[i & (s->cap - 1)] = v;
+  // complete the blocks ending with this value, each from its two halves:
+  for (int k = 1; k <= s->levels && !((i + 1) & ((1UL << k) - 1)); k++) {
+    unsigned long c = (i >> k) << 1;
+    int m = (s->cap >> k) - 1, mc = (s->cap >> (k - 1)) - 1;
+    float l0, h0, l1, h1;
+    if (k == 1) {
+      l0 = h0 = s->val[c & mc];
+      l1 = h1 = s->val[(c + 1) & mc];
+    } else {
+      l0 = s->lo[k-1][c & mc]; h0 = s->hi[k-1][c & mc];
+      l1 = s->lo[k-1][(c + 1) & mc]; h1 = s->hi[k-1][(c + 1) & mc];
+    }
+    s->lo[k][(i >> k) & m] = l0 < l1 ? l0 : l1;
+    s->hi[k][(i >> k) & m] = h0 > h1 ? h0 : h1;
+  }
+}
+
+// Gets the minimum and maximum of the values a..b-1 from the largest
+// complete blocks, returns 0 if none of them is still stored.
+static int stream_range(const Fl_Chart_Stream *s, unsigned long a, unsigned long b,
+			float &lo, float &hi) {
+  if (s->total > (unsigned long)s->cap && a < s->total - s->cap)
+    a = s->total - s->cap;
+  if (b > s->total) b = s->total;
+  if (a >= b) return 0;
+  lo = FLT_MAX; hi = -FLT_MAX;
+  while (a < b) {
+    int k = 0;
+    while (k < s->levels && !(a & ((2UL << k) - 1)) && a + (2UL << k) <= b) k++;
+    float l, h;
+    if (k) {
+      int m = (s->cap >> k) - 1;
+      l = s->lo[k][(a >> k) & m];
+      h = s->hi[k][(a >> k) & m];
+    } else {
+      l = h = s->val[a & (s->cap - 1)];
+    }
+    if (l < lo) lo = l;
+    if (h > hi) hi = h;
+    a += 1UL << k;
+  }
+  return 1;
+}
+
+// Gets the values a..b-1 shown in pixel column j
+static void stream_column(double spc, unsigned long j, unsigned long &a, unsigned long &b) {
+  a = (unsigned long)(j * spc);
+  b = (unsigned long)((j + 1) * spc);
+  if (b <= a) b = a + 1;
+}
+
+// Draws the columns from..to of a plot starting with column first at x.
+// y and h is the vertical extent, min the value at the bottom.
+static void stream_draw(const Fl_Chart_Stream *s, int type, double spc,
+			unsigned long first, unsigned long from, unsigned long to,
+			int x, int y, int h, double min, double incr) {
+  for (unsigned long j = from; j <= to; j++) {
+    unsigned long a, b;
+    float lo, hi, plo, phi;
+    stream_column(spc, j, a, b);
+    if (!stream_range(s, a, b, lo, hi)) continue;
+    if (type == FL_BAR_CHART || type == FL_FILL_CHART || type == FL_SPIKE_CHART) {
+      // filled from the base line
+      if (lo > 0.0f) lo = 0.0f;
+      if (hi < 0.0f) hi = 0.0f;
+    } else if (j) {
+      // a line, joined to the previous column
+      stream_column(spc, j - 1, a, b);
+      if (stream_range(s, a, b, plo, phi)) {
+	if (lo > phi) lo = phi;
+	if (hi < plo) hi = plo;
+      }
+    }
+    int top = y + h - (int)rint((hi - min) * incr);
+    int bottom = y + h - (int)rint((lo - min) * incr);
+    fl_rectf(x + (int)(j - first), top, 1, bottom - top + 1);
+  }
+}
+
+void Fl_Chart::draw_stream() {
+  Fl_Chart_Stream *s = stream_;
+  Fl_Boxtype b = box();
+  int xx = x()+Fl::box_dx(b);
+  int yy = y()+Fl::box_dy(b);
+  int ww = w()-Fl::box_dw(b);
+  int hh = h()-Fl::box_dh(b);
+
+  draw_box();
+  if (ww <= 0 || hh <= 0) return;
+  fl_push_clip(xx, yy, ww, hh);
+
+  // each pixel column shows cap/ww values, the newest is in column jr:
+  double spc = s->cap / double(ww);
+  unsigned long jr = s->total ? (unsigned long)ceil(s->total / spc) - 1 : 0;
+  unsigned long j0 = jr >= (unsigned long)ww ? jr - ww + 1 : 0;
+
+  // the bounds, or the range of the values shown including 0:
+  double lo = min, hi = max;
+  if (lo >= hi) {
+    unsigned long a, e;
+    float l, h;
+    stream_column(spc, j0, a, e);
+    lo = hi = 0.0;
+    if (stream_range(s, a, s->total, l, h)) {
+      if (l < lo) lo = l;
+      if (h > hi) hi = h;
+    }
+    if (lo >= hi) hi = lo + 1.0;
+  }
+  double incr = (hh - 1) / (hi - lo);
+
+  // keep the plot in a surface only where it is pixel exact:
+  cairo_t *cr = Fl::cairo_cc();
+  cairo_surface_t *old = 0;
+  if (cr && Fl_Surface_Device::surface() == Fl_Display_Device::display_device()) {
+    cairo_matrix_t m;
+    cairo_get_matrix(cr, &m);
+    if (m.xx != 1.0 || m.yy != 1.0 || m.xy != 0.0 || m.yx != 0.0 ||
+	m.x0 != floor(m.x0) || m.y0 != floor(m.y0))
+      cr = 0;
+  } else {
+    cr = 0;
+  }
+
+  unsigned long from = j0;
+  if (cr) {
+    if (s->surface && s->w == ww && s->h == hh && s->min == lo && s->max == hi &&
+	s->type == type() && s->color == textcolor() &&
+	!(damage() & ~FL_DAMAGE_USER1) &&
+	j0 >= s->j0 && jr >= s->jr && j0 - s->j0 < (unsigned long)ww) {
+      // only new values were added: scroll the plot, then draw the
+      // last column again and the new ones
+      if (j0 > s->j0) {
+	old = s->surface;
+	s->surface = 0;
+      }
+      from = s->jr > j0 ? s->jr : j0;
+    } else if (s->surface) {
+      cairo_surface_destroy(s->surface);
+      s->surface = 0;
+    }
+
+    if (!s->surface) {
+      s->surface = cairo_surface_create_similar(cairo_get_target(cr),
+						CAIRO_CONTENT_COLOR_ALPHA, ww, hh);
+      s->w = ww;
+      s->h = hh;
+      if (cairo_surface_status(s->surface) != CAIRO_STATUS_SUCCESS) {
+	cairo_surface_destroy(s->surface);
+	s->surface = 0;
+	if (old) cairo_surface_destroy(old);
+	cr = 0;
+      }
+    }
+  }
+
+  if (!cr) {
+    fl_color(textcolor());
+    stream_draw(s, type(), spc, j0, j0, jr, xx, yy, hh - 1, lo, incr);
+  } else {
+    cairo_t *old_cc = fl_cairo_context;
+    fl_cairo_context = cairo_create(s->surface);
+    fl_push_no_clip();
+
+    if (old) {
+      cairo_set_source_surface(fl_cairo_context, old, -(double)(j0 - s->j0), 0);
+      cairo_paint(fl_cairo_context);
+      cairo_surface_destroy(old);
+    }
+    cairo_save(fl_cairo_context);
+    cairo_set_operator(fl_cairo_context, CAIRO_OPERATOR_CLEAR);
+    cairo_rectangle(fl_cairo_context, (double)(from - j0), 0, ww, hh);
+    cairo_fill(fl_cairo_context);
+    cairo_restore(fl_cairo_context);
+
+    fl_color(textcolor());
+    stream_draw(s, type(), spc, j0, from, jr, 0, 0, hh - 1, lo, incr);
+
+    fl_pop_clip();
+    cairo_destroy(fl_cairo_context);
+    fl_cairo_context = old_cc;
+
+    s->j0 = j0;
+    s->jr = jr;
+    s->min = lo;
+    s->max = hi;
+    s->type = type();
+    s->color = textcolor();
+
+    cairo_save(cr);
+    cairo_set_source_surface(cr, s->surface, xx, yy);
+    cairo_rectangle(cr, xx, yy, ww, hh);
+    cairo_fill(cr);
+    cairo_restore(cr);
+  }
+
+  /* Draw base line */
+  fl_color(textcolor());
+  fl_xyline(xx, yy + hh - 1 - (int)rint(-lo * incr), xx + ww - 1);
+
+  draw_label();
+  fl_pop_clip();
+}
+
 void Fl_Chart::draw() {
 
+    if (stream_) {
+	draw_stream();
+	return;
+    }
+
     draw_box();
     Fl_Boxtype b = box();
     int xx = x()+Fl::box_dx(b); // was 9 instead of dx...
@@ -304,6 +546,7 @@ Fl_Widget(X,Y,W,H,L) {
   textsize_  = 10;
   textcolor_ = FL_FOREGROUND_COLOR;
   entries    = (FL_CHART_ENTRY *)calloc(sizeof(FL_CHART_ENTRY), FL_CHART_MAX + 1);
+  stream_    = 0;
 }
 
 /**
@@ -311,6 +554,7 @@ Fl_Widget(X,Y,W,H,L) {
  */
 Fl_Chart::~Fl_Chart() {
   free(entries);
+  if (stream_) stream_free(stream_);
 }
 
 /**
@@ -318,6 +562,7 @@ Fl_Chart::~Fl_Chart() {
  */
 void Fl_Chart::clear() {
   numb = 0;
+  if (stream_) stream_->total = 0;
   min = max = 0;
   redraw();
 }
@@ -330,6 +575,12 @@ void Fl_Chart::clear() {
   \param[in] col optional data color
  */
 void Fl_Chart::add(double val, const char *str, unsigned col) {
+  if (stream_) {
+    stream_add(stream_, float(val));
+    if (numb < stream_->cap) numb++;
+    damage(FL_DAMAGE_USER1);
+    return;
+  }
   /* Allocate more entries if required */
   if (numb >= sizenumb) {
     sizenumb += FL_CHART_MAX;
@@ -361,7 +612,7 @@ void Fl_Chart::add(double val, const char *str, unsigned col) {
  */
 void Fl_Chart::insert(int ind, double val, const char *str, unsigned col) {
   int i;
-  if (ind < 1 || ind > numb+1) return;
+  if (stream_ || ind < 1 || ind > numb+1) return;
   /* Allocate more entries if required */
   if (numb >= sizenumb) {
     sizenumb += FL_CHART_MAX;
@@ -390,7 +641,7 @@ void Fl_Chart::insert(int ind, double val, const char *str, unsigned col) {
   \param[in] col optional data color
  */
 void Fl_Chart::replace(int ind,double val, const char *str, unsigned col) {
-  if (ind < 1 || ind > numb) return;
+  if (stream_ || ind < 1 || ind > numb) return;
   entries[ind-1].val = float(val);
   entries[ind-1].col = col;
   if (str) {
@@ -431,6 +682,64 @@ void Fl_Chart::maxsize(int m) {
   }
 }
 
+/**
+  Switches the chart to streaming mode, keeping the last \p n values.
+
+  In streaming mode add() appends a value in constant time, dropping
+  the oldest one once \p n values are stored. Labels and colors are
+  not stored: the values are drawn in textcolor() across the
+  width of the chart, with the newest at the right, and insert() and
+  replace() do nothing. Unless bounds(double, double) are set, the
+  chart is scaled to the values shown each time it is drawn.
+
+  Only FL_BAR_CHART, FL_FILL_CHART and FL_SPIKE_CHART, which are filled
+  from the base line, and FL_LINE_CHART are drawn, all other types are
+  drawn like FL_LINE_CHART.
+
+  If the memory for the values cannot be allocated, the chart is left
+  out of streaming mode and stream() returns 0.
+
+  \param[in] n number of values to keep, rounded up to a power of two,
+             or 0 to leave streaming mode. All values are removed.
+ */
+void Fl_Chart::stream(int n) {
+  if (stream_) {
+    stream_free(stream_);
+    stream_ = 0;
+  }
+  numb = 0;
+  if (n > 0) {
+    Fl_Chart_Stream *s = new Fl_Chart_Stream;
+    memset(s, 0, sizeof(Fl_Chart_Stream));
+    s->cap = 1;
+    while (s->cap < n && s->levels < 30) {
+      s->cap <<= 1;
+      s->levels++;
+    }
+    s->val = (float *)malloc(sizeof(float) * s->cap);
+    int ok = s->val != 0;
+    for (int k = 1; k <= s->levels; k++) {
+      s->lo[k] = (float *)malloc(sizeof(float) * (s->cap >> k));
+      s->hi[k] = (float *)malloc(sizeof(float) * (s->cap >> k));
+      if (!s->lo[k] || !s->hi[k]) ok = 0;
+    }
+    if (ok)
+      stream_ = s;
+    else
+      stream_free(s);
+  }
+  redraw();
+}
+
+/**
+  Returns the number of values kept in streaming mode, or 0 if the
+  chart is not in streaming mode.
+  \see stream(int)
+ */
+int Fl_Chart::stream() const {
+  return stream_ ? stream_->cap : 0;
+}
+
 //
 // End of "$Id: Fl_Chart.cxx 7903 2010-11-28 21:06:39Z matt $".
 //
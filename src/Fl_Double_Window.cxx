@@ -295,6 +295,42 @@ extern void fl_restore_clip();
 # error unsupported platform
 #endif
 
+/* Copy the parts of the back buffer covered by /r/ (the whole window
+ * if /r/ is NULL) to the front. Only the rectangles making up the
+ * damage region are composited, so a single small widget changing in
+ * a large window costs a blit of that widget's area. */
+static void copy_back_buffer( Fl_X *myi, Fl_Region r, int W, int H )
+{
+  cairo_t *cr = myi->cc;
+
+  cairo_save( cr );
+
+  /* the rectangles already describe the area, don't let a stale clip
+   * widen or narrow it */
+  cairo_reset_clip( cr );
+  cairo_identity_matrix( cr );
+
+  if ( r )
+  {
+      cairo_rectangle_int_t rect;
+
+      for ( int i = cairo_region_num_rectangles( r ); --i >= 0; )
+      {
+          cairo_region_get_rectangle( r, i, &rect );
+
+          cairo_rectangle( cr, rect.x, rect.y, rect.width, rect.height );
+      }
+  }
+  else
+      cairo_rectangle( cr, 0, 0, W, H );
+
+  cairo_set_source_surface( cr, cairo_get_target( myi->other_cc ), 0, 0 );
+  cairo_set_operator( cr, CAIRO_OPERATOR_SOURCE );
+  cairo_fill( cr );
+
+  cairo_restore( cr );
+}
+
 /**
   Forces the window to be redrawn.
 */
@@ -344,10 +380,7 @@ void Fl_Double_Window::flush(int eraseoverlay) {
          waste it and redraw everything just because one widget wants to
          change its border color */
 
-      cairo_set_source_surface( myi->cc, cairo_get_target( myi->other_cc ), 0, 0 );
-      cairo_set_operator( myi->cc, CAIRO_OPERATOR_SOURCE );
-      cairo_paint( myi->cc );
-      cairo_set_operator( myi->cc, CAIRO_OPERATOR_OVER );
+      copy_back_buffer( myi, myi->region, w(), h() );
   }
 
   if (damage() & ~FL_DAMAGE_EXPOSE) {
@@ -406,10 +439,7 @@ void Fl_Double_Window::flush(int eraseoverlay) {
   // the current clip region:
 
 #if 1 // FLTK_USE_CAIRO
-  cairo_set_source_surface( myi->cc, cairo_get_target( myi->other_cc ), 0, 0 );
-  cairo_set_operator( myi->cc, CAIRO_OPERATOR_SOURCE );
-  cairo_paint( myi->cc );
-  cairo_set_operator( myi->cc, CAIRO_OPERATOR_OVER );
+  copy_back_buffer( myi, eraseoverlay ? 0 : myi->region, w(), h() );
 #else
   int X,Y,W,H; fl_clip_box(0,0,w(),h(),X,Y,W,H);
   if (myi->other_xid) fl_copy_offscreen(X, Y, W, H, myi->other_xid, X, Y);
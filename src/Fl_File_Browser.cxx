@@ -33,20 +33,36 @@
 //   Fl_File_Browser::Fl_File_Browser() - Create a Fl_File_Browser widget.
 //   Fl_File_Browser::load()            - Load a directory into the browser.
 //   Fl_File_Browser::filter()          - Set the filename filter.
+//   Fl_File_Browser::start_scan()      - Start loading a directory in the background.
+//   Fl_File_Browser::scan_cb()         - Add entries from a background scan.
+//   Fl_File_Browser::add_scanned()     - Insert a scanned entry in sorted order.
+//   Fl_File_Browser::cancel_load()     - Stop a background scan.
 //
 
 //
 // Include necessary header files...
 //
 
+#include <FL/Fl.H>
 #include <FL/Fl_File_Browser.H>
 #include <FL/fl_draw.H>
 #include <FL/filename.H>
+#include <FL/fl_utf8.h>
 #include <FL/Fl_Image.H>	// icon
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "flstring.h"
 
+#ifdef WIN32
+#  include <process.h>
+#elif HAVE_PTHREAD
+#  include <pthread.h>
+#  include <unistd.h>
+#endif // WIN32
+
 #ifdef __CYGWIN__
 #  include <mntent.h>
 #elif defined(WIN32)
@@ -83,12 +99,17 @@
 //    FL_BLINE should be private to Fl_Browser, and not re-defined here.
 //    For now, make sure this struct is precisely consistent with Fl_Browser.cxx.
 //
+struct FL_BLINE_CHUNK;
+
 struct FL_BLINE			// data is in a linked list of these
 {
   FL_BLINE	*prev;		// Previous item in list
   FL_BLINE	*next;		// Next item in list
   void		*data;		// Pointer to data (function)
   Fl_Image      *icon;		// Pointer to optional icon
+  FL_BLINE_CHUNK *chunk;	// Chunk of Fl_Browser's line index
+  int		height;		// Height counted in full_height()
+  int		width;		// Measured width, or -1
   short		length;		// sizeof(txt)-1, may be longer than string
   char		flags;		// selected, displayed
   char		txt[1];		// start of allocated array
@@ -409,6 +430,27 @@ Fl_File_Browser::Fl_File_Browser(int        X,  // I - Upper-lefthand X coordina
   directory_ = "";
   iconsize_  = (uchar)(3 * textsize() / 2);
   filetype_  = FILES;
+  async_load_ = 0;
+  show_hidden_ = 1;
+  scan_      = 0;
+  load_cb_   = 0;
+  load_data_ = 0;
+}
+
+
+//
+// 'Fl_File_Browser::~Fl_File_Browser()' - Destroy a Fl_File_Browser widget.
+//
+
+Fl_File_Browser::~Fl_File_Browser()
+{
+  cancel_load();
+}
+
+
+// a hidden file, but not the parent directory
+static int is_hidden(const char *name) {
+  return name[0] == '.' && strcmp(name, "../") != 0;
 }
 
 
@@ -429,6 +471,7 @@ Fl_File_Browser::load(const char     *directory,// I - Directory to load
 
 //  printf("Fl_File_Browser::load(\"%s\")\n", directory);
 
+  cancel_load();
   clear();
 
   directory_ = directory;
@@ -589,8 +632,14 @@ Fl_File_Browser::load(const char     *directory,// I - Directory to load
     else if (filename[i] != '/' && filename[i] != '\\')
       strlcat(filename, "/", sizeof(filename));
 
+    if (async_load_ && start_scan(filename, sort))
+      return (1);
+
     num_files = fl_filename_list(filename, &files, sort);
 #else
+    if (async_load_ && start_scan(directory_, sort))
+      return (1);
+
     num_files = fl_filename_list(directory_, &files, sort);
 #endif /* WIN32 || __EMX__ */
 
@@ -598,7 +647,8 @@ Fl_File_Browser::load(const char     *directory,// I - Directory to load
       return (0);
 
     for (i = 0, num_dirs = 0; i < num_files; i ++) {
-      if (strcmp(files[i]->d_name, "./")) {
+      if (strcmp(files[i]->d_name, "./") &&
+          (show_hidden_ || !is_hidden(files[i]->d_name))) {
 	snprintf(filename, sizeof(filename), "%s/%s", directory_,
 	         files[i]->d_name);
 
@@ -638,6 +688,466 @@ Fl_File_Browser::filter(const char *pattern)	// I - Pattern string
 }
 
 
+//
+// Background directory scanning...
+//
+// The worker thread reads the directory and finds the type of each
+// entry, so that a slow file system does not block the user interface.
+// Finished entries are queued in an Fl_File_Scan, and Fl::awake() runs
+// Fl_File_Browser::scan_cb() in the main thread to add them to the
+// browser.  The scan is reference counted: the browser, the worker and
+// a queued awake handler each hold one reference, so whichever is done
+// last frees it, even when the browser has been cancelled or deleted.
+//
+
+#if defined(WIN32) || HAVE_PTHREAD
+#  define FL_FILE_SCAN_THREADS 1
+#else
+#  define FL_FILE_SCAN_THREADS 0
+#endif // WIN32 || HAVE_PTHREAD
+
+#define FL_FILE_SCAN_BATCH	64	// entries in the first batch
+#define FL_FILE_SCAN_MAXBATCH	4096	// entries in later batches
+
+struct Fl_File_Scan
+{
+  Fl_File_Browser *browser;		// Browser, or 0 after cancel_load()
+  char		*directory;		// Directory to list
+  char		*pattern;		// Copy of the filter pattern
+  int		filetype;		// Copy of the file type
+  Fl_File_Sort_F *sort;			// Sort function
+  Fl_Awake_Handler handler;		// Fl_File_Browser::scan_cb()
+  int		refs;			// References to this scan
+  int		cancelled;		// Non-zero when the worker should stop
+  int		done;			// Non-zero when all entries are queued
+  int		notified;		// Non-zero while scan_cb() is queued
+  struct dirent	**ents;			// Queued entries...
+  char		*types;			// ...and their Fl_File_Icon types
+  int		nents, aents;
+#ifdef WIN32
+  CRITICAL_SECTION mutex;
+#elif HAVE_PTHREAD
+  pthread_mutex_t mutex;
+#endif // WIN32
+};
+
+#if FL_FILE_SCAN_THREADS
+
+static void scan_lock(Fl_File_Scan *s) {
+#ifdef WIN32
+  EnterCriticalSection(&s->mutex);
+#else
+  pthread_mutex_lock(&s->mutex);
+#endif // WIN32
+}
+
+static void scan_unlock(Fl_File_Scan *s) {
+#ifdef WIN32
+  LeaveCriticalSection(&s->mutex);
+#else
+  pthread_mutex_unlock(&s->mutex);
+#endif // WIN32
+}
+
+static void scan_sleep() {
+#ifdef WIN32
+  Sleep(10);
+#else
+  usleep(10000);
+#endif // WIN32
+}
+
+// drop one reference, freeing the scan when it was the last one
+static void scan_release(Fl_File_Scan *s) {
+  scan_lock(s);
+  int refs = --s->refs;
+  scan_unlock(s);
+  if (refs) return;
+
+  for (int i = 0; i < s->nents; i ++) free(s->ents[i]);
+  free(s->ents);
+  free(s->types);
+  free(s->directory);
+  free(s->pattern);
+#ifdef WIN32
+  DeleteCriticalSection(&s->mutex);
+#else
+  pthread_mutex_destroy(&s->mutex);
+#endif // WIN32
+  delete s;
+}
+
+// queue scan_cb() unless it is queued already; returns 0 if the
+// awake queue was full and nothing was queued
+static int scan_notify(Fl_File_Scan *s) {
+  scan_lock(s);
+  if (s->notified) {
+    scan_unlock(s);
+    return 1;
+  }
+  s->notified = 1;
+  s->refs ++;
+  scan_unlock(s);
+
+  if (Fl::awake(s->handler, s) == 0) return 1;
+
+  scan_lock(s);
+  s->notified = 0;
+  scan_unlock(s);
+  scan_release(s);
+  return 0;
+}
+
+// queue an entry for the browser, taking ownership of it if it is
+// shown; returns 0 if the entry is not wanted
+static int scan_add(Fl_File_Scan *s, struct dirent *de, int type, int &batch) {
+  if (type != Fl_File_Icon::DIRECTORY &&
+      (s->filetype != Fl_File_Browser::FILES ||
+       !fl_filename_match(de->d_name, s->pattern)))
+    return 0;
+
+  scan_lock(s);
+  if (s->nents >= s->aents) {
+    s->aents = s->aents ? 2 * s->aents : FL_FILE_SCAN_BATCH;
+    s->ents  = (struct dirent **)realloc(s->ents, s->aents * sizeof(struct dirent *));
+    s->types = (char *)realloc(s->types, s->aents);
+  }
+  s->ents[s->nents]  = de;
+  s->types[s->nents] = (char)type;
+  int n = ++ s->nents;
+  scan_unlock(s);
+
+  if (n >= batch && scan_notify(s) && batch < FL_FILE_SCAN_MAXBATCH)
+    batch *= 2;
+
+  return 1;
+}
+
+static int scan_cancelled(Fl_File_Scan *s) {
+  scan_lock(s);
+  int c = s->cancelled;
+  scan_unlock(s);
+  return c;
+}
+
+// the worker thread
+static void scan_directory(Fl_File_Scan *s) {
+  int batch = FL_FILE_SCAN_BATCH;
+
+#ifdef WIN32
+  // The Windows scandir() gets the directory flag along with the name,
+  // so listing the directory is cheap and there is nothing to stat...
+  struct dirent	**files;
+  int		num_files = fl_filename_list(s->directory, &files, s->sort);
+
+  for (int i = 0; i < num_files; i ++) {
+    const char *name = files[i]->d_name;
+    int len = strlen(name);
+
+    if (!scan_cancelled(s) && strcmp(name, "./") &&
+        scan_add(s, files[i], (len && name[len - 1] == '/') ?
+	         Fl_File_Icon::DIRECTORY : Fl_File_Icon::PLAIN, batch))
+      continue;
+
+    free(files[i]);
+  }
+
+  if (num_files > 0) free(files);
+#else
+  // Elsewhere read the directory one entry at a time, so that entries
+  // show up while a slow file system is still being listed...
+  char	*dirloc;				// Directory in locale encoding
+  int	dirlen = strlen(s->directory);
+
+#  ifdef __APPLE__
+  dirloc = s->directory;
+#  else
+  dirloc = (char *)malloc(dirlen + 1);
+  fl_utf8to_mb(s->directory, dirlen, dirloc, dirlen + 1);
+#  endif // __APPLE__
+
+  DIR	*dir = opendir(dirloc);
+
+  if (dir) {
+    struct dirent	*e;			// Current entry
+    struct stat		fileinfo;		// Information on file
+    int			loclen = strlen(dirloc);
+    char		*fullname = (char *)malloc(loclen + FL_PATH_MAX + 2);
+    char		*name = fullname + loclen;
+
+    memcpy(fullname, dirloc, loclen);
+    if (name != fullname && name[-1] != '/')
+      *name++ = '/';
+
+    while (!scan_cancelled(s) && (e = readdir(dir)) != NULL) {
+      int len = strlen(e->d_name);
+
+      if (!strcmp(e->d_name, ".") || len > FL_PATH_MAX)
+        continue;
+
+      // Find the file type, as Fl_File_Icon::find() would...
+      int type = Fl_File_Icon::PLAIN;
+
+      memcpy(name, e->d_name, len + 1);
+      if (!stat(fullname, &fileinfo)) {
+        if (S_ISDIR(fileinfo.st_mode))
+          type = Fl_File_Icon::DIRECTORY;
+#  ifdef S_IFIFO
+        else if (S_ISFIFO(fileinfo.st_mode))
+          type = Fl_File_Icon::FIFO;
+#  endif // S_IFIFO
+      }
+
+      // Copy the entry, converting the name to UTF-8 and adding a
+      // '/' to directories like fl_filename_list() does...
+#  ifdef __APPLE__
+      int newlen = len;
+#  else
+      int newlen = fl_utf8from_mb(NULL, 0, e->d_name, len);
+#  endif // __APPLE__
+      struct dirent *de = (struct dirent *)malloc(e->d_name - (char *)e + newlen + 2);
+
+      memcpy(de, e, e->d_name - (char *)e);
+#  ifdef __APPLE__
+      strcpy(de->d_name, e->d_name);
+#  else
+      fl_utf8from_mb(de->d_name, newlen + 1, e->d_name, len);
+#  endif // __APPLE__
+      if (type == Fl_File_Icon::DIRECTORY && newlen && de->d_name[newlen - 1] != '/')
+        strcpy(de->d_name + newlen, "/");
+
+      if (!scan_add(s, de, type, batch))
+        free(de);
+    }
+
+    free(fullname);
+    closedir(dir);
+  }
+
+#  ifndef __APPLE__
+  free(dirloc);
+#  endif // !__APPLE__
+#endif // WIN32
+
+  scan_lock(s);
+  s->done = 1;
+  scan_unlock(s);
+
+  // The last batch must get through, so wait for room in the queue...
+  while (!scan_notify(s) && !scan_cancelled(s))
+    scan_sleep();
+
+  scan_release(s);
+}
+
+#ifdef WIN32
+static void __cdecl scan_thread(void *d) {
+  scan_directory((Fl_File_Scan *)d);
+}
+#else
+static void *scan_thread(void *d) {
+  scan_directory((Fl_File_Scan *)d);
+  return 0;
+}
+#endif // WIN32
+
+#endif // FL_FILE_SCAN_THREADS
+
+
+//
+// 'Fl_File_Browser::start_scan()' - Start loading a directory in the background.
+//
+
+int						// O - 1 if started, 0 if not
+Fl_File_Browser::start_scan(const char     *directory,// I - Directory to list
+                            Fl_File_Sort_F *sort)	// I - Sort function to use
+{
+#if FL_FILE_SCAN_THREADS
+  Fl_File_Scan	*s = new Fl_File_Scan;
+
+  memset(s, 0, sizeof(Fl_File_Scan));
+  s->browser   = this;
+  s->directory = strdup(directory);
+  s->pattern   = strdup(pattern_);
+  s->filetype  = filetype_;
+  s->sort      = sort;
+  s->handler   = scan_cb;
+  s->refs      = 2;				// browser and worker
+
+#  ifdef WIN32
+  InitializeCriticalSection(&s->mutex);
+  if (_beginthread(scan_thread, 0, s) != (uintptr_t)-1L) {
+    scan_ = s;
+    return (1);
+  }
+#  else
+  pthread_t	t;
+
+  pthread_mutex_init(&s->mutex, NULL);
+  if (!pthread_create(&t, NULL, scan_thread, s)) {
+    pthread_detach(t);
+    scan_ = s;
+    return (1);
+  }
+#  endif // WIN32
+
+  // No thread, so load the directory the usual way...
+  s->refs = 1;
+  scan_release(s);
+#else
+  (void)directory;
+  (void)sort;
+#endif // FL_FILE_SCAN_THREADS
+
+  return (0);
+}
+
+
+//
+// 'Fl_File_Browser::scan_cb()' - Add entries from a background scan.
+//
+// Runs in the main thread, queued by the worker with Fl::awake().
+//
+
+void
+Fl_File_Browser::scan_cb(void *d)	// I - Fl_File_Scan
+{
+#if FL_FILE_SCAN_THREADS
+  Fl_File_Scan		*s = (Fl_File_Scan *)d;
+  struct dirent		**ents;
+  char			*types;
+  int			i, n, done;
+
+  // Take everything queued so far. The worker may queue one more
+  // scan_cb() after this one has seen done, so only this one keeps the
+  // browser, and that later call does nothing...
+  scan_lock(s);
+  Fl_File_Browser *fb = s->browser;
+  ents  = s->ents;
+  types = s->types;
+  n     = s->nents;
+  done  = s->done;
+  s->ents     = 0;
+  s->types    = 0;
+  s->nents    = 0;
+  s->aents    = 0;
+  s->notified = 0;
+  if (done) s->browser = 0;
+  scan_unlock(s);
+
+  if (fb && fb->scan_ == s) {
+    if (n) {
+      struct dirent *tmp = (struct dirent *)calloc(1, offsetof(struct dirent, d_name) +
+                                                   FL_PATH_MAX + 2);
+
+      for (i = 0; i < n; i ++)
+        fb->add_scanned(ents[i], types[i], s->sort, tmp);
+
+      free(tmp);
+    }
+
+    if (done) {
+      fb->scan_ = 0;
+      scan_release(s);				// the browser's reference, once
+    }
+
+    if (fb->load_cb_ && (n || done))
+      (*fb->load_cb_)(fb, fb->load_data_);
+  }
+
+  for (i = 0; i < n; i ++) free(ents[i]);
+  free(ents);
+  free(types);
+
+  scan_release(s);				// the awake handler's reference
+#else
+  (void)d;
+#endif // FL_FILE_SCAN_THREADS
+}
+
+
+//
+// 'Fl_File_Browser::add_scanned()' - Insert a scanned entry in sorted order.
+//
+// Directories come first, as in load(), and each group is kept sorted
+// with the sort function, so the entries can arrive in any order.
+//
+
+void
+Fl_File_Browser::add_scanned(struct dirent  *de,	// I - Entry to add
+                             int            type,	// I - Fl_File_Icon type
+			     Fl_File_Sort_F *sort,	// I - Sort function
+			     struct dirent  *tmp)	// I - Scratch entry for sort
+{
+  char		filename[4096];			// Full name of file
+  const char	*t;				// Text of a line
+  int		lo, hi, mid;			// Binary search
+  int		isdir = type == Fl_File_Icon::DIRECTORY;
+
+
+  if (!show_hidden_ && is_hidden(de->d_name)) return;
+
+
+  // Find the first line that is not a directory...
+  lo = 1;
+  hi = size() + 1;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    t   = text(mid);
+    if (t && *t && t[strlen(t) - 1] == '/') lo = mid + 1;
+    else hi = mid;
+  }
+
+  if (isdir) {
+    hi = lo;
+    lo = 1;
+  } else
+    hi = size() + 1;
+
+  // ...and then the place of this entry in its group
+  if (sort) {
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      t   = text(mid);
+      strlcpy(tmp->d_name, t ? t : "", FL_PATH_MAX + 2);
+      if ((*sort)(&de, &tmp) < 0) hi = mid;
+      else lo = mid + 1;
+    }
+  } else
+    lo = hi;
+
+  snprintf(filename, sizeof(filename), "%s/%s", directory_, de->d_name);
+
+  insert(lo, de->d_name, Fl_File_Icon::find(filename, type));
+}
+
+
+//
+// 'Fl_File_Browser::cancel_load()' - Stop a background scan.
+//
+
+/**
+  Stops a background load(), leaving the entries that were added so
+  far in the browser. The load_callback() is not called again.
+*/
+void
+Fl_File_Browser::cancel_load()
+{
+#if FL_FILE_SCAN_THREADS
+  Fl_File_Scan	*s = scan_;
+
+  if (!s) return;
+
+  scan_ = 0;
+  scan_lock(s);
+  s->cancelled = 1;
+  s->browser   = 0;
+  scan_unlock(s);
+  scan_release(s);				// the browser's reference
+#endif // FL_FILE_SCAN_THREADS
+}
+
+
 //
 // End of "$Id: Fl_File_Browser.cxx 8063 2010-12-19 21:20:10Z matt $".
 //
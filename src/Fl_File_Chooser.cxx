@@ -351,6 +351,7 @@ void Fl_File_Chooser::filter_value(int f) {
 }
 
 void Fl_File_Chooser::hide() {
+  fileList->cancel_load();
   window->hide();
 }
 
@@ -106,12 +106,22 @@
   	<TD>sort</TD>
   	<TD>fl_numericsort</TD>
   </TR>
+ <TR>
+  	<TD>async_load</TD>
+  	<TD>0</TD>
+  </TR>
   </TABLE></CENTER>
 
   The Fl_File_Chooser::sort member specifies the sort function that is
   used when loading the contents of a directory and can be customized
   at run-time.
 
+  Setting the Fl_File_Chooser::async_load member to a non-zero value
+  makes the chooser read directories in a background thread, so that
+  large or slow directories do not block the user interface.  The
+  program must call Fl::lock() before showing the chooser, see
+  Fl_File_Browser::async_load(int).
+
   The Fl_File_Chooser class also exports the Fl_File_Chooser::newButton
   and Fl_File_Chooser::previewButton widgets so that application developers
   can control their appearance and use.  For more complex customization,
@@ -324,6 +334,7 @@
 //   Fl_File_Chooser::favoritesButtonCB() - Handle favorites selections.
 //   Fl_File_Chooser::fileListCB()        - Handle clicks (and double-clicks)
 //                                          in the Fl_File_Browser.
+//   Fl_File_Chooser::fileListLoadCB()    - Handle entries from a background load.
 //   Fl_File_Chooser::fileNameCB()        - Handle text entry in the FileBrowser.
 //   Fl_File_Chooser::showChoiceCB()      - Handle show selections.
 //   compare_dirnames()                   - Compare two directory names.
@@ -399,6 +410,7 @@ const char	*Fl_File_Chooser::save_label = "Save";
 const char	*Fl_File_Chooser::show_label = "Show:";
 const char      *Fl_File_Chooser::hidden_label = "Show hidden files";
 Fl_File_Sort_F	*Fl_File_Chooser::sort = fl_numericsort;
+int		Fl_File_Chooser::async_load = 0;
 
 
 //
@@ -1116,6 +1128,23 @@ void Fl_File_Chooser::preview(int e)
 }
 
 
+//
+// 'Fl_File_Chooser::fileListLoadCB()' - Handle entries from a background load.
+//
+
+void
+Fl_File_Chooser::fileListLoadCB(Fl_File_Browser *fb,	// I - File browser
+                                void            *d) {	// I - File chooser
+  Fl_File_Chooser *fc = (Fl_File_Chooser *)d;
+
+  if (fb->loading()) return;
+
+  // The directory is complete, so finish what rescan() started...
+  fc->update_preview();
+  fc->select_filename();
+}
+
+
 //
 // 'Fl_File_Chooser::previewCB()' - Timeout handler for the preview box.
 //
@@ -1150,10 +1179,13 @@ Fl_File_Chooser::rescan()
     okButton->deactivate();
 
   // Build the file list...
-  fileList->load(directory_, sort);
-#ifndef WIN32	
-  if (!showHiddenButton->value()) remove_hidden_files();
+  fileList->async_load(async_load);
+  fileList->load_callback(fileListLoadCB, this);
+#ifndef WIN32
+  fileList->show_hidden(showHiddenButton->value());
 #endif
+  fileList->load(directory_, sort);
+  if (fileList->loading()) return;
   // Update the preview box...
   update_preview();
 }
@@ -1172,19 +1204,35 @@ void Fl_File_Chooser::rescan_keep_filename()
     return;
   }
 
-  int   i;
-  char	pathname[FL_PATH_MAX];		// New pathname for filename field
-  strlcpy(pathname, fn, sizeof(pathname));
-
   // Build the file list...
-  fileList->load(directory_, sort);
-#ifndef WIN32	
-  if (!showHiddenButton->value()) remove_hidden_files();
+  fileList->async_load(async_load);
+  fileList->load_callback(fileListLoadCB, this);
+#ifndef WIN32
+  fileList->show_hidden(showHiddenButton->value());
 #endif
+  fileList->load(directory_, sort);
+  if (fileList->loading()) return;
   // Update the preview box...
   update_preview();
 
   // and select the chosen file
+  select_filename();
+}
+
+//
+// 'Fl_File_Chooser::select_filename()' - Select the file named in the filename field.
+//
+
+void
+Fl_File_Chooser::select_filename()
+{
+  const char *fn = fileName->value();
+  if (!fn || !*fn || fn[strlen(fn) - 1]=='/') return;
+
+  int   i;
+  char	pathname[FL_PATH_MAX];		// New pathname for filename field
+  strlcpy(pathname, fn, sizeof(pathname));
+
   char found = 0;
   char *slash = strrchr(pathname, '/');
   if (slash) 
@@ -1594,6 +1642,7 @@ void Fl_File_Chooser::show()
 
 void Fl_File_Chooser::showHidden(int value)
 {
+  fileList->show_hidden(value);
   if (value) {
     fileList->load(directory());
   } else {
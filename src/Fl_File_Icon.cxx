@@ -43,6 +43,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <FL/fl_utf8.h>
 #include "flstring.h"
 #include <errno.h>
@@ -81,6 +82,213 @@
 Fl_File_Icon	*Fl_File_Icon::first_ = (Fl_File_Icon *)0;
 
 
+//
+// Pattern index for find()...
+//
+// Nearly all icon patterns are "*", "*.ext", "*.{ext1|ext2|...}" or a
+// plain filename, so instead of calling fl_filename_match() for every
+// icon, find() looks the name and each of its ".ext" suffixes up in a
+// hash table.  The remaining patterns are only matched when they come
+// before the best icon found so far and the file ends with the literal
+// text they end with.  The index is rebuilt the next time find() is
+// called after an icon has been created or destroyed.
+//
+
+struct Fl_File_Icon_Key {	// Hashed suffix or name
+  char		*key;		// Lower case ".ext" or filename
+  int		name;		// 1 for a filename, 0 for a suffix
+  int		prio;		// Position in the icon list
+  Fl_File_Icon	*icon;		// Icon
+  int		type;		// Icon type
+  Fl_File_Icon_Key *next;	// Next key in the bucket
+};
+
+struct Fl_File_Icon_Glob {	// Any other pattern
+  const char	*pattern;	// Pattern
+  const char	*tail;		// Literal text at the end of the pattern
+  int		tlen;		// Length of tail
+  int		prio;		// Position in the icon list
+  Fl_File_Icon	*icon;		// Icon
+  int		type;		// Icon type
+};
+
+static int		icon_changes = 1;	// Bumped when an icon comes or goes
+static int		index_changes = 0;	// Value of icon_changes when built
+static Fl_File_Icon_Key	**index_table = 0;	// Hash buckets
+static unsigned		index_size = 0;		// Number of buckets
+static Fl_File_Icon_Glob *index_globs = 0;	// Other patterns, by priority
+static int		index_nglobs = 0;
+static Fl_File_Icon	*index_star[Fl_File_Icon::DIRECTORY + 1];
+						// First "*" icon for each type
+static int		index_starprio[Fl_File_Icon::DIRECTORY + 1];
+
+
+// FNV-1a of the lower case text
+static unsigned index_hash(const char *s, int len, int name) {
+  unsigned h = 2166136261u ^ (unsigned)name;
+  for (int i = 0; i < len; i ++) {
+    h ^= (unsigned char)tolower((unsigned char)s[i]);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// characters with a meaning in fl_filename_match()
+static int index_special(char c) {
+  return c == '*' || c == '?' || c == '[' || c == ']' || c == '{' ||
+         c == '}' || c == '|' || c == ',' || c == '\\';
+}
+
+static int index_literal(const char *s, int len) {
+  for (int i = 0; i < len; i ++)
+    if (index_special(s[i]) || s[i] == '/') return 0;
+  return 1;
+}
+
+static void index_clear() {
+  for (unsigned i = 0; i < index_size; i ++) {
+    Fl_File_Icon_Key *k, *next;
+    for (k = index_table[i]; k; k = next) {
+      next = k->next;
+      free(k->key);
+      delete k;
+    }
+  }
+  free(index_table);
+  free(index_globs);
+  index_table  = 0;
+  index_size   = 0;
+  index_globs  = 0;
+  index_nglobs = 0;
+}
+
+static void index_add_key(const char *key, int len, int name, int prio,
+                          Fl_File_Icon *icon) {
+  Fl_File_Icon_Key *k = new Fl_File_Icon_Key, **kp;
+
+  k->key = (char *)malloc(len + 1);
+  for (int i = 0; i < len; i ++) k->key[i] = (char)tolower((unsigned char)key[i]);
+  k->key[len] = '\0';
+  k->name = name;
+  k->prio = prio;
+  k->icon = icon;
+  k->type = icon->type();
+  k->next = 0;
+
+  // Keep the keys of each bucket in priority order...
+  for (kp = index_table + (index_hash(key, len, name) & (index_size - 1)); *kp;
+       kp = &((*kp)->next));
+  *kp = k;
+}
+
+// sort the patterns of all icons into the index
+static void index_build() {
+  Fl_File_Icon	*icon;
+  int		prio, n, t;
+
+  index_clear();
+
+  for (n = 0, icon = Fl_File_Icon::first(); icon; icon = icon->next(), n ++);
+  for (index_size = 16; index_size < (unsigned)n * 2; index_size *= 2);
+  index_table = (Fl_File_Icon_Key **)calloc(index_size, sizeof(Fl_File_Icon_Key *));
+  index_globs = (Fl_File_Icon_Glob *)malloc((n + 1) * sizeof(Fl_File_Icon_Glob));
+
+  for (t = 0; t <= Fl_File_Icon::DIRECTORY; t ++) {
+    index_star[t]     = 0;
+    index_starprio[t] = n;
+  }
+
+  for (prio = 0, icon = Fl_File_Icon::first(); icon; icon = icon->next(), prio ++) {
+    const char	*p = icon->pattern();
+    int		len = p ? strlen(p) : 0;
+
+    if (!p) continue;
+
+    // "*" matches everything of its type...
+    if (!strcmp(p, "*")) {
+      for (t = 0; t <= Fl_File_Icon::DIRECTORY; t ++)
+        if ((icon->type() == t || icon->type() == Fl_File_Icon::ANY) && !index_star[t]) {
+          index_star[t]     = icon;
+          index_starprio[t] = prio;
+	}
+      continue;
+    }
+
+    // "*.ext" and "*.{ext1|ext2}" match by suffix...
+    if (p[0] == '*' && p[1] == '.') {
+      if (index_literal(p + 1, len - 1)) {
+        index_add_key(p + 1, len - 1, 0, prio, icon);
+        continue;
+      }
+
+      if (p[2] == '{' && p[len - 1] == '}' && len > 4) {
+        // Alternatives, which may only contain '|' or ',' separators...
+        const char *a, *b;
+        int ok = 1;
+	for (a = p + 3; a < p + len - 1; a ++)
+	  if (*a != '|' && *a != ',' && (index_special(*a) || *a == '/')) ok = 0;
+
+        if (ok) {
+	  char key[1024];
+	  for (a = p + 3; a < p + len; a = b + 1) {
+	    for (b = a; b < p + len - 1 && *b != '|' && *b != ','; b ++);
+	    if (b - a + 2 > (int)sizeof(key)) { ok = 0; break; }
+	    key[0] = '.';
+	    memcpy(key + 1, a, b - a);
+	    index_add_key(key, (int)(b - a) + 1, 0, prio, icon);
+	  }
+	  if (ok) continue;
+	}
+      }
+    }
+
+    // A plain filename...
+    if (len && index_literal(p, len)) {
+      index_add_key(p, len, 1, prio, icon);
+      continue;
+    }
+
+    // Anything else is matched the slow way, but only when the file ends
+    // with the literal text at the end of the pattern...
+    Fl_File_Icon_Glob *g = index_globs + index_nglobs ++;
+    int tl;
+
+    for (tl = 0; tl < len && !index_special(p[len - tl - 1]); tl ++);
+    if (tl < len && !strchr("*?]}\\", p[len - tl - 1]))
+      tl = 0;			// e.g. "a|b", where the tail is optional
+
+    g->pattern = p;
+    g->tail    = p + len - tl;
+    g->tlen    = tl;
+    g->prio    = prio;
+    g->icon    = icon;
+    g->type    = icon->type();
+  }
+
+  index_changes = icon_changes;
+}
+
+// the first key for the text that fits the file type
+static void index_lookup(const char *s, int len, int name, int filetype,
+                         Fl_File_Icon **best, int *bestprio) {
+  Fl_File_Icon_Key *k;
+
+  for (k = index_table[index_hash(s, len, name) & (index_size - 1)]; k; k = k->next) {
+    if (k->prio >= *bestprio) break;
+    if (k->name != name || (k->type != filetype && k->type != Fl_File_Icon::ANY))
+      continue;
+
+    int i;
+    for (i = 0; i < len && k->key[i] == (char)tolower((unsigned char)s[i]); i ++);
+    if (i == len && !k->key[len]) {
+      *best     = k->icon;
+      *bestprio = k->prio;
+      break;
+    }
+  }
+}
+
+
 /**
   Creates a new Fl_File_Icon with the specified information.
   \param[in] p filename pattern
@@ -114,6 +322,7 @@ Fl_File_Icon::Fl_File_Icon(const char *p,	/* I - Filename pattern */
   // And add the icon to the list of icons...
   next_  = first_;
   first_ = this;
+  icon_changes ++;
 }
 
 
@@ -140,6 +349,8 @@ Fl_File_Icon::~Fl_File_Icon() {
       first_ = current->next_;
   }
 
+  icon_changes ++;
+
   // Free any memory used...
   if (alloc_data_)
     free(data_);
@@ -235,13 +446,48 @@ Fl_File_Icon::find(const char *filename,// I - Name of file */
   // Look at the base name in the filename
   name = fl_filename_name(filename);
 
-  // Loop through the available file types and return any match that
-  // is found...
-  for (current = first_; current != (Fl_File_Icon *)0; current = current->next_)
-    if ((current->type_ == filetype || current->type_ == ANY) &&
-        (fl_filename_match(filename, current->pattern_) ||
-	 fl_filename_match(name, current->pattern_)))
+  if (filetype < ANY || filetype > DIRECTORY) {
+    // Not a type the index knows about; loop through the available file
+    // types and return any match that is found...
+    for (current = first_; current != (Fl_File_Icon *)0; current = current->next_)
+      if ((current->type_ == filetype || current->type_ == ANY) &&
+          (fl_filename_match(filename, current->pattern_) ||
+	   fl_filename_match(name, current->pattern_)))
+        break;
+
+    return (current);
+  }
+
+  if (index_changes != icon_changes)
+    index_build();
+
+  // Start with "*", then look for the name and each ".ext" suffix of it...
+  const char	*ptr;
+  int		namelen = strlen(name);
+  int		flen = strlen(filename);
+  int		prio = index_starprio[filetype];
+
+  current = index_star[filetype];
+
+  index_lookup(name, namelen, 1, filetype, &current, &prio);
+  for (ptr = name; *ptr; ptr ++)
+    if (*ptr == '.')
+      index_lookup(ptr, namelen - (int)(ptr - name), 0, filetype, &current, &prio);
+
+  // ...and finally any other pattern that comes before the match
+  for (int i = 0; i < index_nglobs && index_globs[i].prio < prio; i ++) {
+    Fl_File_Icon_Glob *g = index_globs + i;
+
+    if ((g->type != filetype && g->type != ANY) || g->tlen > flen ||
+        strncasecmp(filename + flen - g->tlen, g->tail, g->tlen))
+      continue;
+
+    if (fl_filename_match(filename, g->pattern) ||
+        fl_filename_match(name, g->pattern)) {
+      current = g->icon;
       break;
+    }
+  }
 
   // Return the match (if any)...
   return (current);
@@ -35,7 +35,292 @@
 #include <FL/Fl_Group.H>
 #include <FL/Fl_Window.H>
 #include <FL/fl_draw.H>
+#include <FL/Fl_Device.H>
+#include <FL/Fl_Cairo.H>
 #include <stdlib.h>
+#include <math.h>
+
+// retained rendering of a cached group, see Fl_Group::cache(int)
+struct Fl_Group_Cache {
+  cairo_surface_t *surface;
+  int w, h;			// size rendered, -1 if stale
+  unsigned generation;
+  unsigned long hits, renders;
+};
+
+static unsigned cache_generation;
+
+// Spatial index of the children of a group, see Fl_Group::index_children(int).
+// Children are entered into every grid cell their box overlaps, except for
+// children covering more than MAX_CELLS cells, which go into a list that
+// is always searched. Each child gets an ordinal that follows its position
+// in the group, so hits can be returned in stacking order.
+
+struct Fl_Group_Index_Entry {
+  Fl_Widget* w;
+  unsigned ord;
+};
+
+struct Fl_Group_Index_Cell {
+  Fl_Group_Index_Cell* next;
+  int cx, cy;
+  Fl_Group_Index_Entry* e;
+  int n, N;
+};
+
+struct Fl_Group_Index_Child {
+  Fl_Group_Index_Child* next;
+  Fl_Widget* w;
+  unsigned ord;
+  int cx0, cy0, cx1, cy1;	// cells covered, none if cx1 < cx0
+  char big;			// in the big_ list instead
+};
+
+class Fl_Group_Index {
+  enum { MAX_CELLS = 64 };
+
+  Fl_Group_Index_Cell** cells_;
+  int ncells_, Ncells_;
+  Fl_Group_Index_Child** kids_;
+  int nkids_, Nkids_;
+  Fl_Group_Index_Entry* big_;
+  int nbig_, Nbig_;
+
+  int div(int v) const { return v >= 0 ? v / cell : -((-v - 1) / cell) - 1; }
+  static unsigned hash(int cx, int cy) {
+    return (unsigned)cx * 73856093U ^ (unsigned)cy * 19349663U;
+  }
+  static unsigned hash(Fl_Widget* w) {
+    return (unsigned)((unsigned long)w >> 4);
+  }
+  Fl_Group_Index_Cell* find_cell(int cx, int cy, int create);
+  Fl_Group_Index_Child** find_kid(Fl_Widget* w);
+  void place(Fl_Group_Index_Child* k);
+  void unplace(Fl_Group_Index_Child* k);
+  void grow_kids();
+
+public:
+  int cell;			// cell size in pixels
+  int dirty;			// rebuild before use
+  unsigned next_ord;
+
+  Fl_Group_Index(int c);
+  ~Fl_Group_Index();
+  void clear();
+  void add(Fl_Widget* w, unsigned ord);
+  void remove(Fl_Widget* w);
+  void move(Fl_Widget* w);
+  int find(int x, int y, Fl_Widget** hits, int size);
+};
+
+Fl_Group_Index::Fl_Group_Index(int c) {
+  cell = c;
+  dirty = 1;
+  next_ord = 0;
+  ncells_ = 0; Ncells_ = 64;
+  cells_ = (Fl_Group_Index_Cell**)calloc(Ncells_, sizeof(Fl_Group_Index_Cell*));
+  nkids_ = 0; Nkids_ = 64;
+  kids_ = (Fl_Group_Index_Child**)calloc(Nkids_, sizeof(Fl_Group_Index_Child*));
+  big_ = 0; nbig_ = Nbig_ = 0;
+}
+
+Fl_Group_Index::~Fl_Group_Index() {
+  clear();
+  free(cells_);
+  free(kids_);
+  free(big_);
+}
+
+// Forgets all children and marks the index for a rebuild.
+void Fl_Group_Index::clear() {
+  int i;
+  for (i = 0; i < Ncells_; i++) {
+    Fl_Group_Index_Cell* c = cells_[i];
+    while (c) {
+      Fl_Group_Index_Cell* next = c->next;
+      free(c->e);
+      delete c;
+      c = next;
+    }
+    cells_[i] = 0;
+  }
+  for (i = 0; i < Nkids_; i++) {
+    Fl_Group_Index_Child* k = kids_[i];
+    while (k) {
+      Fl_Group_Index_Child* next = k->next;
+      delete k;
+      k = next;
+    }
+    kids_[i] = 0;
+  }
+  ncells_ = nkids_ = nbig_ = 0;
+  next_ord = 0;
+  dirty = 1;
+}
+
+Fl_Group_Index_Cell* Fl_Group_Index::find_cell(int cx, int cy, int create) {
+  Fl_Group_Index_Cell* c;
+  for (c = cells_[hash(cx, cy) & (Ncells_ - 1)]; c; c = c->next)
+    if (c->cx == cx && c->cy == cy) return c;
+  if (!create) return 0;
+  if (ncells_ >= 2 * Ncells_) {	// double the number of buckets
+    int N = 2 * Ncells_;
+    Fl_Group_Index_Cell** t = (Fl_Group_Index_Cell**)calloc(N, sizeof(Fl_Group_Index_Cell*));
+    for (int i = 0; i < Ncells_; i++) {
+      while ((c = cells_[i])) {
+	cells_[i] = c->next;
+	unsigned h = hash(c->cx, c->cy) & (N - 1);
+	c->next = t[h];
+	t[h] = c;
+      }
+    }
+    free(cells_);
+    cells_ = t;
+    Ncells_ = N;
+  }
+  c = new Fl_Group_Index_Cell;
+  c->cx = cx; c->cy = cy;
+  c->e = 0; c->n = c->N = 0;
+  unsigned h = hash(cx, cy) & (Ncells_ - 1);
+  c->next = cells_[h];
+  cells_[h] = c;
+  ncells_++;
+  return c;
+}
+
+Fl_Group_Index_Child** Fl_Group_Index::find_kid(Fl_Widget* w) {
+  Fl_Group_Index_Child** p = &kids_[hash(w) & (Nkids_ - 1)];
+  while (*p && (*p)->w != w) p = &(*p)->next;
+  return p;
+}
+
+void Fl_Group_Index::grow_kids() {
+  int N = 2 * Nkids_;
+  Fl_Group_Index_Child** t = (Fl_Group_Index_Child**)calloc(N, sizeof(Fl_Group_Index_Child*));
+  for (int i = 0; i < Nkids_; i++) {
+    Fl_Group_Index_Child* k;
+    while ((k = kids_[i])) {
+      kids_[i] = k->next;
+      unsigned h = hash(k->w) & (N - 1);
+      k->next = t[h];
+      t[h] = k;
+    }
+  }
+  free(kids_);
+  kids_ = t;
+  Nkids_ = N;
+}
+
+// Enters a child into the cells its current box overlaps:
+void Fl_Group_Index::place(Fl_Group_Index_Child* k) {
+  Fl_Widget* w = k->w;
+  k->big = 0;
+  if (w->w() <= 0 || w->h() <= 0) {
+    k->cx0 = k->cy0 = 0; k->cx1 = k->cy1 = -1;
+    return;
+  }
+  k->cx0 = div(w->x()); k->cx1 = div(w->x() + w->w() - 1);
+  k->cy0 = div(w->y()); k->cy1 = div(w->y() + w->h() - 1);
+  Fl_Group_Index_Entry e;
+  e.w = w; e.ord = k->ord;
+  if ((double)(k->cx1 - k->cx0 + 1) * (k->cy1 - k->cy0 + 1) > MAX_CELLS) {
+    k->big = 1;
+    if (nbig_ >= Nbig_) {
+      Nbig_ = Nbig_ ? 2 * Nbig_ : 16;
+      big_ = (Fl_Group_Index_Entry*)realloc(big_, Nbig_ * sizeof(Fl_Group_Index_Entry));
+    }
+    big_[nbig_++] = e;
+    return;
+  }
+  for (int cy = k->cy0; cy <= k->cy1; cy++)
+    for (int cx = k->cx0; cx <= k->cx1; cx++) {
+      Fl_Group_Index_Cell* c = find_cell(cx, cy, 1);
+      if (c->n >= c->N) {
+	c->N = c->N ? 2 * c->N : 4;
+	c->e = (Fl_Group_Index_Entry*)realloc(c->e, c->N * sizeof(Fl_Group_Index_Entry));
+      }
+      c->e[c->n++] = e;
+    }
+}
+
+// Takes a child out of the cells it was entered into:
+void Fl_Group_Index::unplace(Fl_Group_Index_Child* k) {
+  int i;
+  if (k->big) {
+    for (i = 0; i < nbig_; i++)
+      if (big_[i].w == k->w) { big_[i] = big_[--nbig_]; break; }
+    return;
+  }
+  for (int cy = k->cy0; cy <= k->cy1; cy++)
+    for (int cx = k->cx0; cx <= k->cx1; cx++) {
+      Fl_Group_Index_Cell* c = find_cell(cx, cy, 0);
+      if (!c) continue;
+      for (i = 0; i < c->n; i++)
+	if (c->e[i].w == k->w) { c->e[i] = c->e[--c->n]; break; }
+    }
+}
+
+void Fl_Group_Index::add(Fl_Widget* w, unsigned ord) {
+  if (nkids_ >= 2 * Nkids_) grow_kids();
+  Fl_Group_Index_Child** p = find_kid(w);
+  if (*p) {			// already there, just update it
+    unplace(*p);
+    (*p)->ord = ord;
+    place(*p);
+    return;
+  }
+  Fl_Group_Index_Child* k = new Fl_Group_Index_Child;
+  k->next = 0;
+  k->w = w;
+  k->ord = ord;
+  *p = k;
+  nkids_++;
+  place(k);
+}
+
+void Fl_Group_Index::remove(Fl_Widget* w) {
+  Fl_Group_Index_Child** p = find_kid(w);
+  Fl_Group_Index_Child* k = *p;
+  if (!k) return;
+  unplace(k);
+  *p = k->next;
+  nkids_--;
+  delete k;
+}
+
+void Fl_Group_Index::move(Fl_Widget* w) {
+  Fl_Group_Index_Child* k = *find_kid(w);
+  if (!k) return;
+  unplace(k);
+  place(k);
+}
+
+// Stores the children whose box contains x,y in stacking order (bottom
+// first) in hits, and returns how many there are. Returns -1 if there
+// are more than size.
+int Fl_Group_Index::find(int x, int y, Fl_Widget** hits, int size) {
+  unsigned ords[64];
+  int n = 0, i, j;
+  if (size > 64) size = 64;
+  Fl_Group_Index_Cell* c = find_cell(div(x), div(y), 0);
+  int nc = c ? c->n : 0;
+  for (i = -nbig_; i < nc; i++) {
+    Fl_Group_Index_Entry& e = i < 0 ? big_[-1 - i] : c->e[i];
+    Fl_Widget* w = e.w;
+    if (x < w->x() || y < w->y() || x >= w->x() + w->w() || y >= w->y() + w->h())
+      continue;
+    if (n >= size) return -1;
+    // insertion sort, there are only a few:
+    for (j = n; j > 0 && ords[j-1] > e.ord; j--) {
+      ords[j] = ords[j-1];
+      hits[j] = hits[j-1];
+    }
+    ords[j] = e.ord;
+    hits[j] = w;
+    n++;
+  }
+  return n;
+}
 
 Fl_Group* Fl_Group::current_;
 
@@ -95,6 +380,7 @@ Fl_Group *Fl_Group::current() {return current_;}
 void Fl_Group::current(Fl_Group *g) {current_ = g;}
 
 extern Fl_Widget* fl_oldfocus; // set by Fl::focus
+extern Fl_Widget* fl_shortcut_tried; // in Fl.cxx
 
 // For back-compatibility, we must adjust all events sent to child
 // windows so they are relative to that window.
@@ -147,11 +433,33 @@ static int navkey() {
   return 0;
 }
 
+// The most children below the mouse that handle() looks up in the
+// spatial index; if there are more it goes through all of them.
+#define GROUP_HITS 32
+
+// Sets a to the children that may be below the mouse, in stacking
+// order, and returns how many there are.
+int Fl_Group::under_mouse(Fl_Widget** hits, Fl_Widget*const*& a) {
+  a = array();
+  if (!index_) return children_;
+  if (index_->dirty) {
+    index_->clear();
+    for (int i = 0; i < children_; i++) index_->add(a[i], i);
+    index_->next_ord = children_;
+    index_->dirty = 0;
+  }
+  int n = index_->find(Fl::event_x(), Fl::event_y(), hits, GROUP_HITS);
+  if (n < 0) return children_;
+  a = hits;
+  return n;
+}
+
 int Fl_Group::handle(int event) {
 
   Fl_Widget*const* a = array();
   int i;
   Fl_Widget* o;
+  Fl_Widget* hits[GROUP_HITS];
 
   switch (event) {
 
@@ -180,12 +488,14 @@ int Fl_Group::handle(int event) {
   case FL_SHORTCUT:
     for (i = children(); i--;) {
       o = a[i];
-      if (o->takesevents() && Fl::event_inside(o) && send(o,FL_SHORTCUT))
+      if (o != fl_shortcut_tried &&
+          o->takesevents() && Fl::event_inside(o) && send(o,FL_SHORTCUT))
 	return 1;
     }
     for (i = children(); i--;) {
       o = a[i];
-      if (o->takesevents() && !Fl::event_inside(o) && send(o,FL_SHORTCUT))
+      if (o != fl_shortcut_tried &&
+          o->takesevents() && !Fl::event_inside(o) && send(o,FL_SHORTCUT))
 	return 1;
     }
     if ((Fl::event_key() == FL_Enter || Fl::event_key() == FL_KP_Enter)) return navigation(FL_Down);
@@ -193,7 +503,7 @@ int Fl_Group::handle(int event) {
 
   case FL_ENTER:
   case FL_MOVE:
-    for (i = children(); i--;) {
+    for (i = under_mouse(hits, a); i--;) {
       o = a[i];
       if (o->visible() && Fl::event_inside(o)) {
 	if (o->contains(Fl::belowmouse())) {
@@ -209,7 +519,7 @@ int Fl_Group::handle(int event) {
 
   case FL_DND_ENTER:
   case FL_DND_DRAG:
-    for (i = children(); i--;) {
+    for (i = under_mouse(hits, a); i--;) {
       o = a[i];
       if (o->takesevents() && Fl::event_inside(o)) {
 	if (o->contains(Fl::belowmouse())) {
@@ -224,7 +534,7 @@ int Fl_Group::handle(int event) {
     return 0;
 
   case FL_PUSH:
-    for (i = children(); i--;) {
+    for (i = under_mouse(hits, a); i--;) {
       o = a[i];
       if (o->takesevents() && Fl::event_inside(o)) {
 	Fl_Widget_Tracker wp(o);
@@ -242,7 +552,7 @@ int Fl_Group::handle(int event) {
     if (o == this) return 0;
     else if (o) send(o,event);
     else {
-      for (i = children(); i--;) {
+      for (i = under_mouse(hits, a); i--;) {
 	o = a[i];
 	if (o->takesevents() && Fl::event_inside(o)) {
 	  if (send(o,event)) return 1;
@@ -371,6 +681,8 @@ Fl_Group::Fl_Group(int X,int Y,int W,int H,const char *l)
   savedfocus_ = 0;
   resizable_ = this;
   sizes_ = 0; // this is allocated when first resize() is done
+  cache_ = 0;
+  index_ = 0;
   // Subclasses may want to construct child objects as part of their
   // constructor, so make sure they are add()'d to this object.
   // But you must end() the object!
@@ -387,6 +699,7 @@ void Fl_Group::clear() {
   savedfocus_ = 0;
   resizable_ = this;
   init_sizes();
+  if (index_) index_->clear();
 
   // we must change the Fl::pushed() widget, if it is one of
   // the group's children. Otherwise fl_fix_focus() would send
@@ -450,6 +763,11 @@ void Fl_Group::clear() {
 */
 Fl_Group::~Fl_Group() {
   clear();
+  if (cache_) {
+    if (cache_->surface) cairo_surface_destroy(cache_->surface);
+    delete cache_;
+  }
+  delete index_;
 }
 
 /**
@@ -469,6 +787,7 @@ void Fl_Group::insert(Fl_Widget &o, int index) {
     g->remove(n);
   }
   o.parent_ = this;
+  if (cache_) cache_->w = -1;
   if (children_ == 0) { // use array pointer to point at single child
     array_ = (Fl_Widget**)&o;
   } else if (children_ == 1) { // go from 1 to 2 children
@@ -483,6 +802,11 @@ void Fl_Group::insert(Fl_Widget &o, int index) {
     int j; for (j = children_; j > index; j--) array_[j] = array_[j-1];
     array_[j] = &o;
   }
+  if (index_ && !index_->dirty) {
+    // appending keeps the stacking order, anything else renumbers it:
+    if (index >= children_) index_->add(&o, index_->next_ord++);
+    else index_->dirty = 1;
+  }
   children_++;
   init_sizes();
 }
@@ -510,6 +834,8 @@ void Fl_Group::remove(int index) {
   if (o.parent_ == this) {	// this should always be true
     o.parent_ = 0;
   } 
+  if (cache_) cache_->w = -1;
+  if (index_ && !index_->dirty) index_->remove(&o);
 
   // remove the widget from the group
 
@@ -740,6 +1066,7 @@ void Fl_Group::draw_children() {
 }
 
 void Fl_Group::draw() {
+ if (cache_ && draw_cached()) return;
  if (damage() & ~FL_DAMAGE_CHILD) { // redraw the entire thing:
     draw_box();
     draw_label();
@@ -747,6 +1074,235 @@ void Fl_Group::draw() {
   draw_children();
 }
 
+////////////////////////////////////////////////////////////////
+// Retained rendering of static groups:
+
+/**
+  Sets whether the group draws from a retained surface.
+
+  A cached group renders its box, label and children into an offscreen
+  cairo surface once, and then redraws by compositing that surface.
+  When children are damaged only they are drawn again, into the
+  surface, and only their area is copied to the window. This makes
+  large, mostly static panels cheap to redraw when the window is
+  exposed, resized or redrawn as a whole.
+
+  The surface is rendered again when the group changes size, when
+  children are added or removed, when redraw() is called on the group
+  itself, and after invalidate_caches().
+
+  Caching only applies to groups drawn by Fl_Group::draw(). Drawing
+  of a cached group is limited to its bounding box. Anything drawn
+  with Xlib directly bypasses the surface and is lost when the group
+  is composited again, so children that use fl_draw_image(),
+  fl_scroll(), rotated text (fl_draw(int angle, ...), which Xft draws)
+  or any text at all after fl_set_cairo_text(0) should not be placed
+  in a cached group.
+
+  \see cache_hits(), cache_renders()
+*/
+void Fl_Group::cache(int c) {
+  if (c && !cache_) {
+    cache_ = new Fl_Group_Cache;
+    cache_->surface = 0;
+    cache_->w = cache_->h = -1;
+    cache_->generation = cache_generation;
+    cache_->hits = cache_->renders = 0;
+    redraw();
+  } else if (!c && cache_) {
+    if (cache_->surface) cairo_surface_destroy(cache_->surface);
+    delete cache_;
+    cache_ = 0;
+    redraw();
+  }
+}
+
+/**
+  Returns how many times a cached group was drawn from its retained
+  surface, or 0 if the group is not cached.
+*/
+unsigned long Fl_Group::cache_hits() const {
+  return cache_ ? cache_->hits : 0;
+}
+
+/**
+  Returns how many times a cached group rendered its retained surface
+  from scratch, or 0 if the group is not cached.
+*/
+unsigned long Fl_Group::cache_renders() const {
+  return cache_ ? cache_->renders : 0;
+}
+
+/**
+  Makes all cached groups render their surfaces again the next time
+  they are drawn. Call this when something all widgets depend on, like
+  the boxtypes or the color map, has changed.
+*/
+void Fl_Group::invalidate_caches() {
+  cache_generation++;
+}
+
+/*
+  Drops the cached surfaces of every group containing o. Called when o
+  is shown, hidden or relabeled: those redraw a parent with a box or the
+  window, not the cached group itself, so draw_cached() cannot tell its
+  surface went stale from the damage alone.
+*/
+void Fl_Group::uncache(Fl_Widget* o) {
+  for (Fl_Group* g = o->parent(); g; g = g->parent())
+    if (g->cache_) g->cache_->w = -1;
+}
+
+/**
+  Sets up a spatial index of the children for hit-testing.
+
+  By default handle() finds the child below the mouse for FL_PUSH,
+  FL_MOVE, FL_ENTER, FL_DND_DRAG and friends by testing all children
+  in turn. For groups with very many children, like the regions of a
+  timeline, this makes every mouse motion expensive. With an index the
+  children are kept in a grid of \p cell by \p cell pixel cells, and
+  only those in the cell below the mouse are tested. Children are still
+  tried from the last one to the first.
+
+  The index follows insert(), remove() and the resize() of children.
+  Children moved without calling Fl_Widget::resize() (for instance by
+  setting x() from a subclass) must be resized or re-added for the
+  index to notice.
+
+  \param[in] cell the size of a grid cell in pixels, 0 removes the index
+*/
+void Fl_Group::index_children(int cell) {
+  if (cell <= 0) {
+    delete index_;
+    index_ = 0;
+  } else if (!index_) {
+    index_ = new Fl_Group_Index(cell);
+  } else if (index_->cell != cell) {
+    index_->clear();
+    index_->cell = cell;
+  }
+}
+
+/**
+  Returns the cell size of the spatial index, or 0 if the group has none.
+  \see void Fl_Group::index_children(int cell)
+*/
+int Fl_Group::index_children() const {
+  return index_ ? index_->cell : 0;
+}
+
+// called by Fl_Widget::resize() when a child moves
+void Fl_Group::index_child(Fl_Widget* o) {
+  if (index_ && !index_->dirty) index_->move(o);
+}
+
+// Draws the group through its retained surface, returns 0 if this is
+// not possible and the group should be drawn directly.
+int Fl_Group::draw_cached() {
+  cairo_t *cr = Fl::cairo_cc();
+
+  if (!cr || w() <= 0 || h() <= 0 ||
+      Fl_Surface_Device::surface() != Fl_Display_Device::display_device())
+    return 0;
+
+  // the surface is only pixel exact under integer translations:
+  cairo_matrix_t m;
+  cairo_get_matrix(cr, &m);
+  if (m.xx != 1.0 || m.yy != 1.0 || m.xy != 0.0 || m.yx != 0.0 ||
+      m.x0 != floor(m.x0) || m.y0 != floor(m.y0))
+    return 0;
+
+  Fl_Group_Cache *c = cache_;
+  int full = damage() & ~FL_DAMAGE_CHILD;
+
+  // A full redraw of the group that its parent is not also doing
+  // comes from redraw() on the group itself:
+  int own = full && !(parent() && (parent()->damage() & ~FL_DAMAGE_CHILD));
+
+  int X = x(), Y = y(), W = w(), H = h();
+
+  if (!c->surface || c->w != W || c->h != H ||
+      c->generation != cache_generation || own) {
+    cairo_surface_t *s =
+      cairo_surface_create_similar(cairo_get_target(cr),
+				   CAIRO_CONTENT_COLOR_ALPHA, W, H);
+    if (cairo_surface_status(s) != CAIRO_STATUS_SUCCESS) {
+      cairo_surface_destroy(s);
+      return 0;
+    }
+    if (c->surface) cairo_surface_destroy(c->surface);
+    c->surface = s;
+    c->w = W;
+    c->h = H;
+    c->generation = cache_generation;
+    c->renders++;
+
+    // draw everything at window coordinates into the surface:
+    cairo_surface_set_device_offset(s, -X, -Y);
+    cairo_t *old_cc = fl_cairo_context;
+    fl_cairo_context = cairo_create(s);
+    fl_push_no_clip();
+
+    clear_damage(FL_DAMAGE_ALL);
+    draw_box();
+    draw_label();
+    draw_children();
+
+    fl_pop_clip();
+    cairo_destroy(fl_cairo_context);
+    fl_cairo_context = old_cc;
+    cairo_surface_set_device_offset(s, 0, 0);
+  } else {
+    // bring the damaged children up to date in the surface and copy
+    // only their area, unless all of the group has to be copied:
+    int dx = X + W, dy = Y + H, dr = X, db = Y;
+    Fl_Widget*const* a = array();
+    int i;
+
+    for (i = 0; i < children_; i++) {
+      Fl_Widget& o = *a[i];
+      if (!o.damage() || !o.visible() || o.type() >= FL_WINDOW) continue;
+      if (o.x() < dx) dx = o.x();
+      if (o.y() < dy) dy = o.y();
+      if (o.x() + o.w() > dr) dr = o.x() + o.w();
+      if (o.y() + o.h() > db) db = o.y() + o.h();
+    }
+
+    if (dr > dx && db > dy) {
+      cairo_surface_set_device_offset(c->surface, -X, -Y);
+      cairo_t *old_cc = fl_cairo_context;
+      fl_cairo_context = cairo_create(c->surface);
+      fl_push_no_clip();
+
+      for (i = 0; i < children_; i++) update_child(*a[i]);
+
+      fl_pop_clip();
+      cairo_destroy(fl_cairo_context);
+      fl_cairo_context = old_cc;
+      cairo_surface_set_device_offset(c->surface, 0, 0);
+    }
+
+    c->hits++;
+
+    if (!full) {
+      if (dx < X) dx = X;
+      if (dy < Y) dy = Y;
+      if (dr > X + W) dr = X + W;
+      if (db > Y + H) db = Y + H;
+      if (dr <= dx || db <= dy) return 1;
+      X = dx; Y = dy; W = dr - dx; H = db - dy;
+    }
+  }
+
+  cairo_save(cr);
+  cairo_set_source_surface(cr, c->surface, x(), y());
+  cairo_rectangle(cr, X, Y, W, H);
+  cairo_fill(cr);
+  cairo_restore(cr);
+
+  return 1;
+}
+
 /**
   Draws a child only if it needs it.
 
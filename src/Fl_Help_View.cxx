@@ -96,6 +96,20 @@ static int	quote_char(const char *);
 static void	scrollbar_callback(Fl_Widget *s, void *);
 static void	hscrollbar_callback(Fl_Widget *s, void *);
 
+//
+// Display list entry types...
+//
+
+enum
+{
+  HV_TEXT,			// Text run
+  HV_XYLINE,			// Underline
+  HV_LINE,			// Horizontal rule
+  HV_RECTF,			// Table cell background
+  HV_RECT,			// Table cell border
+  HV_IMAGE			// Image
+};
+
 //
 // global flag for image loading (see get_image).
 //
@@ -319,6 +333,61 @@ Fl_Help_View::add_block(const char   *s,	// I - Pointer to start of block text
 }
 
 
+/** Adds an entry with the current font and color to the display list. */
+Fl_Help_Op *					// O - Pointer to new entry
+Fl_Help_View::add_op(int t,			// I - Type of entry
+                     int xx,			// I - X position in document
+		     int yy,			// I - Y position in document
+		     int ww,			// I - Width or right edge
+		     int hh)			// I - Height
+{
+  Fl_Help_Op	*temp;				// New entry
+
+
+  if (nops_ >= aops_)
+  {
+    aops_ = aops_ ? 2 * aops_ : 256;
+    ops_  = (Fl_Help_Op *)realloc(ops_, sizeof(Fl_Help_Op) * aops_);
+  }
+
+  temp = ops_ + nops_;
+  memset(temp, 0, sizeof(Fl_Help_Op));
+  temp->type  = (uchar)t;
+  temp->font  = fl_font();
+  temp->size  = fl_size();
+  temp->color = fl_color();
+  temp->x     = xx;
+  temp->y     = yy;
+  temp->w     = ww;
+  temp->h     = hh;
+  temp->pos   = current_pos;
+  nops_ ++;
+
+  return (temp);
+}
+
+
+/** Adds a text run to the display list. */
+void Fl_Help_View::add_text(const char *t,	// I - Text to draw
+                            int        xx,	// I - X position in document
+			    int        yy)	// I - Y position in document
+{
+  int	len = strlen(t) + 1;			// Length of text
+
+
+  if (nopchars_ + len > aopchars_)
+  {
+    aopchars_ = aopchars_ ? 2 * aopchars_ : 4096;
+    if (aopchars_ < nopchars_ + len) aopchars_ = nopchars_ + len;
+    opchars_  = (char *)realloc(opchars_, aopchars_);
+  }
+
+  memcpy(opchars_ + nopchars_, t, len);
+  add_op(HV_TEXT, xx, yy)->text = nopchars_;
+  nopchars_ += len;
+}
+
+
 /** Adds a new link to the list. */
 void Fl_Help_View::add_link(const char *n,	// I - Name of link
                       int        xx,	// I - X position of link
@@ -433,12 +502,16 @@ Fl_Help_View::do_align(Fl_Help_Block *block,	// I - Block to add to
   return (line);
 }
 
-/** Draws the Fl_Help_View widget. */
+/** Lays out the text of all blocks into the display list.
+
+  The HTML between the block boundaries is only parsed once after each
+  format(), draw() then replays the entries of the visible blocks.
+*/
 void
-Fl_Help_View::draw()
+Fl_Help_View::build_ops()
 {
   int			i;		// Looping var
-  const Fl_Help_Block	*block;		// Pointer to current block
+  Fl_Help_Block		*block;		// Pointer to current block
   const char		*ptr,		// Pointer to text in block
 			*attrs;		// Pointer to start of element attributes
   char			*s,		// Pointer into buffer
@@ -451,69 +524,22 @@ Fl_Help_View::draw()
   Fl_Color              fcolor;         // current font color 
   int			head, pre,	// Flags for text
 			needspace;	// Do we need whitespace?
-  Fl_Boxtype		b = box() ? box() : FL_DOWN_BOX;
-					// Box to draw...
   int			underline,	// Underline text?
                         xtra_ww;        // Extra width for underlined space between words
+  Fl_Color		tc = textcolor_;	// Text color, changed by FONT
 
-  // Draw the scrollbar(s) and box first...
-  ww = w();
-  hh = h();
-  i  = 0;
+  nops_     = 0;
+  nopchars_ = 0;
+  ww        = 0;
 
-  draw_box(b, x(), y(), ww, hh, bgcolor_);
-
-  if ( hscrollbar_.visible() || scrollbar_.visible() ) {
-    int scrollsize = scrollbar_size_ ? scrollbar_size_ : Fl::scrollbar_size();
-    int hor_vis = hscrollbar_.visible();
-    int ver_vis = scrollbar_.visible();
-    // Scrollbar corner
-    int scorn_x = x() + ww - (ver_vis?scrollsize:0) - Fl::box_dw(b) + Fl::box_dx(b);
-    int scorn_y = y() + hh - (hor_vis?scrollsize:0) - Fl::box_dh(b) + Fl::box_dy(b);
-    if ( hor_vis ) {
-      if ( hscrollbar_.h() != scrollsize ) {		// scrollsize changed?
-	hscrollbar_.resize(x(), scorn_y, scorn_x - x(), scrollsize);
-	init_sizes();
-      }
-      draw_child(hscrollbar_);
-      hh -= scrollsize;
-    }
-    if ( ver_vis ) {
-      if ( scrollbar_.w() != scrollsize ) {		// scrollsize changed?
-	scrollbar_.resize(scorn_x, y(), scrollsize, scorn_y - y());
-	init_sizes();
-      }
-      draw_child(scrollbar_);
-      ww -= scrollsize;
-    }
-    if ( hor_vis && ver_vis ) {
-      // Both scrollbars visible? Draw little gray box in corner
-      fl_color(FL_GRAY);
-      fl_rectf(scorn_x, scorn_y, scrollsize, scrollsize);
-    }
-  }
-
-  if (!value_)
-    return;
-
-  if (current_view == this && selected) {
-    hv_selection_color      = FL_SELECTION_COLOR;
-    hv_selection_text_color = fl_contrast(textcolor_, FL_SELECTION_COLOR);
-  }
-  current_pos = 0;
-
-  // Clip the drawing to the inside of the box...
-  fl_push_clip(x() + Fl::box_dx(b), y() + Fl::box_dy(b),
-               ww - Fl::box_dw(b), hh - Fl::box_dh(b));
-  fl_color(textcolor_);
-
-  // Draw all visible blocks...
+  // Lay out all blocks...
   for (i = 0, block = blocks_; i < nblocks_; i ++, block ++)
-    if ((block->y + block->h) >= topline_ && block->y < (topline_ + h()))
     {
+      block->op = nops_;
+      current_pos = block->start - value_;
       line      = 0;
       xx        = block->line[line];
-      yy        = block->y - topline_;
+      yy        = block->y;
       hh        = 0;
       pre       = 0;
       head      = 0;
@@ -545,11 +571,10 @@ Fl_Help_View::draw()
 	      hh = 0;
 	    }
 
-            hv_draw(buf, xx + x() - leftline_, yy + y());
+            add_text(buf, xx, yy);
 	    if (underline) {
               xtra_ww = isspace((*ptr)&255)?(int)fl_width(' '):0;
-              fl_xyline(xx + x() - leftline_, yy + y() + 1,
-	                xx + x() - leftline_ + ww + xtra_ww);
+              add_op(HV_XYLINE, xx, yy + 1, ww + xtra_ww);
             }
             current_pos = ptr-value_;
 
@@ -568,10 +593,8 @@ Fl_Help_View::draw()
 	        *s = '\0';
                 s = buf;
 
-                hv_draw(buf, xx + x() - leftline_, yy + y());
-		if (underline) fl_xyline(xx + x() - leftline_, yy + y() + 1,
-	                        	 xx + x() - leftline_ +
-					     (int)fl_width(buf));
+                add_text(buf, xx, yy);
+		if (underline) add_op(HV_XYLINE, xx, yy + 1, (int)fl_width(buf));
 
                 current_pos = ptr-value_;
 		if (line < 31)
@@ -600,10 +623,9 @@ Fl_Help_View::draw()
 	      *s = '\0';
 	      s = buf;
 
-              hv_draw(buf, xx + x() - leftline_, yy + y());
+              add_text(buf, xx, yy);
 	      ww = (int)fl_width(buf);
-	      if (underline) fl_xyline(xx + x() - leftline_, yy + y() + 1,
-	                               xx + x() - leftline_ + ww);
+	      if (underline) add_op(HV_XYLINE, xx, yy + 1, ww);
               xx += ww;
               current_pos = ptr-value_;
 	    }
@@ -667,8 +689,7 @@ Fl_Help_View::draw()
 	  }
 	  else if (strcasecmp(buf, "HR") == 0)
 	  {
-	    fl_line(block->x + x(), yy + y(), block->w + x(),
-	            yy + y());
+	    add_op(HV_LINE, block->x, yy, block->w);
 
 	    if (line < 31)
 	      line ++;
@@ -717,7 +738,7 @@ Fl_Help_View::draw()
 //            buf[fl_unicode2utf(b, 1, buf)] = 0;
               unsigned dstlen = fl_utf8fromwc(buf, 8, b, 1);
               buf[dstlen] = 0;
-              hv_draw(buf, xx - fsize + x() - leftline_, yy + y());
+              add_text(buf, xx - fsize, yy);
 	    }
 
 	    pushfont(font, fsize);
@@ -782,35 +803,20 @@ Fl_Help_View::draw()
 	    else
 	      pushfont(font = textfont_, fsize);
 
-            tx = block->x - 4 - leftline_;
-	    ty = block->y - topline_ - fsize - 3;
+            tx = block->x - 4;
+	    ty = block->y - fsize - 3;
             tw = block->w - block->x + 7;
 	    th = block->h + fsize - 5;
 
-            if (tx < 0)
-	    {
-	      tw += tx;
-	      tx  = 0;
-	    }
-
-	    if (ty < 0)
-	    {
-	      th += ty;
-	      ty  = 0;
-	    }
-
-            tx += x();
-	    ty += y();
-
             if (block->bgcolor != bgcolor_)
 	    {
 	      fl_color(block->bgcolor);
-              fl_rectf(tx, ty, tw, th);
+              add_op(HV_RECTF, tx, ty, tw, th);
               fl_color(textcolor_);
 	    }
 
             if (block->border)
-              fl_rect(tx, ty, tw, th);
+              add_op(HV_RECT, tx, ty, tw, th);
 	  }
 	  else if (strcasecmp(buf, "I") == 0 ||
                    strcasecmp(buf, "EM") == 0)
@@ -884,8 +890,7 @@ Fl_Help_View::draw()
 	    }
 
 	    if (img) {
-	      img->draw(xx + x() - leftline_,
-	                yy + y() - fl_height() + fl_descent() + 2);
+	      add_op(HV_IMAGE, xx, yy - fl_height() + fl_descent() + 2)->img = img;
 	    }
 
 	    xx += ww;
@@ -900,7 +905,7 @@ Fl_Help_View::draw()
 	  *s = '\0';
 	  s = buf;
 
-          hv_draw(buf, xx + x() - leftline_, yy + y());
+          add_text(buf, xx, yy);
 
 	  if (line < 31)
 	    line ++;
@@ -979,11 +984,141 @@ Fl_Help_View::draw()
 
       if (s > buf && !head)
       {
-        hv_draw(buf, xx + x() - leftline_, yy + y());
-	if (underline) fl_xyline(xx + x() - leftline_, yy + y() + 1,
-	                         xx + x() - leftline_ + ww);
+        add_text(buf, xx, yy);
+	if (underline) add_op(HV_XYLINE, xx, yy + 1, ww);
         current_pos = ptr-value_;
       }
+
+      block->nops = nops_ - block->op;
+    }
+
+
+  textcolor_ = tc;
+  ops_valid_ = 1;
+}
+
+
+/** Draws the Fl_Help_View widget. */
+void
+Fl_Help_View::draw()
+{
+  int			i;		// Looping var
+  const Fl_Help_Block	*block;		// Pointer to current block
+  int			xx, yy, ww, hh;	// Current positions and sizes
+  Fl_Boxtype		b = box() ? box() : FL_DOWN_BOX;
+					// Box to draw...
+
+  // Draw the scrollbar(s) and box first...
+  ww = w();
+  hh = h();
+  i  = 0;
+
+  draw_box(b, x(), y(), ww, hh, bgcolor_);
+
+  if ( hscrollbar_.visible() || scrollbar_.visible() ) {
+    int scrollsize = scrollbar_size_ ? scrollbar_size_ : Fl::scrollbar_size();
+    int hor_vis = hscrollbar_.visible();
+    int ver_vis = scrollbar_.visible();
+    // Scrollbar corner
+    int scorn_x = x() + ww - (ver_vis?scrollsize:0) - Fl::box_dw(b) + Fl::box_dx(b);
+    int scorn_y = y() + hh - (hor_vis?scrollsize:0) - Fl::box_dh(b) + Fl::box_dy(b);
+    if ( hor_vis ) {
+      if ( hscrollbar_.h() != scrollsize ) {		// scrollsize changed?
+	hscrollbar_.resize(x(), scorn_y, scorn_x - x(), scrollsize);
+	init_sizes();
+      }
+      draw_child(hscrollbar_);
+      hh -= scrollsize;
+    }
+    if ( ver_vis ) {
+      if ( scrollbar_.w() != scrollsize ) {		// scrollsize changed?
+	scrollbar_.resize(scorn_x, y(), scrollsize, scorn_y - y());
+	init_sizes();
+      }
+      draw_child(scrollbar_);
+      ww -= scrollsize;
+    }
+    if ( hor_vis && ver_vis ) {
+      // Both scrollbars visible? Draw little gray box in corner
+      fl_color(FL_GRAY);
+      fl_rectf(scorn_x, scorn_y, scrollsize, scrollsize);
+    }
+  }
+
+  if (!value_)
+    return;
+
+  if (current_view == this && selected) {
+    hv_selection_color      = FL_SELECTION_COLOR;
+    hv_selection_text_color = fl_contrast(textcolor_, FL_SELECTION_COLOR);
+  }
+  current_pos = 0;
+
+  // Clip the drawing to the inside of the box...
+  fl_push_clip(x() + Fl::box_dx(b), y() + Fl::box_dy(b),
+               ww - Fl::box_dw(b), hh - Fl::box_dh(b));
+  fl_color(textcolor_);
+
+  // Draw all visible blocks...
+  if (!ops_valid_) build_ops();
+
+  int dx = x() - leftline_, dy = y() - topline_;
+
+  for (i = 0, block = blocks_; i < nblocks_; i ++, block ++)
+    if ((block->y + block->h) >= topline_ && block->y < (topline_ + h()))
+    {
+      const Fl_Help_Op *op = ops_ + block->op;
+
+      for (int n = block->nops; n > 0; n --, op ++)
+      {
+        fl_color(op->color);
+
+        switch (op->type)
+	{
+	  case HV_TEXT :
+	    fl_font(op->font, op->size);
+	    current_pos = op->pos;
+	    hv_draw(opchars_ + op->text, op->x + dx, op->y + dy);
+	    break;
+
+	  case HV_XYLINE :
+	    fl_xyline(op->x + dx, op->y + dy, op->x + op->w + dx);
+	    break;
+
+	  case HV_LINE :
+	    fl_line(op->x + x(), op->y + dy, op->w + x(), op->y + dy);
+	    break;
+
+	  case HV_RECTF :
+	  case HV_RECT :
+	    xx = op->x - leftline_;
+	    yy = op->y - topline_;
+	    ww = op->w;
+	    hh = op->h;
+
+            if (xx < 0)
+	    {
+	      ww += xx;
+	      xx  = 0;
+	    }
+
+	    if (yy < 0)
+	    {
+	      hh += yy;
+	      yy  = 0;
+	    }
+
+	    if (op->type == HV_RECTF)
+	      fl_rectf(xx + x(), yy + y(), ww, hh);
+	    else
+	      fl_rect(xx + x(), yy + y(), ww, hh);
+	    break;
+
+	  case HV_IMAGE :
+	    op->img->draw(op->x + dx, op->y + dy);
+	    break;
+	}
+      }
     }
 
   fl_pop_clip();
@@ -1102,6 +1237,7 @@ void Fl_Help_View::format() {
   {
     // Reset state variables...
     done       = 1;
+    ops_valid_ = 0;
     nblocks_   = 0;
     nlinks_    = 0;
     ntargets_  = 0;
@@ -2393,6 +2529,19 @@ Fl_Help_View::free_data() {
     blocks_  = 0;
   }
 
+  if (ops_) {
+    free(ops_);
+    free(opchars_);
+
+    aops_     = 0;
+    nops_     = 0;
+    ops_      = 0;
+    aopchars_ = 0;
+    nopchars_ = 0;
+    opchars_  = 0;
+  }
+  ops_valid_ = 0;
+
   if (nlinks_) {
     free(links_);
 
@@ -3055,6 +3204,14 @@ Fl_Help_View::Fl_Help_View(int        xx,	// I - Left position
   nblocks_      = 0;
   blocks_       = (Fl_Help_Block *)0;
 
+  aops_         = 0;
+  nops_         = 0;
+  ops_          = (Fl_Help_Op *)0;
+  aopchars_     = 0;
+  nopchars_     = 0;
+  opchars_      = (char *)0;
+  ops_valid_    = 0;
+
   link_         = (Fl_Help_Func *)0;
 
   alinks_       = 0;
@@ -3240,6 +3397,17 @@ Fl_Help_View::resize(int xx,	// I - New left position
 					// Box to draw...
 
 
+  if (ww == w() && hh == h() && nblocks_)
+  {
+    // Just moved, the layout of the document does not change...
+    int dx = xx - x(), dy = yy - y();
+
+    Fl_Widget::resize(xx, yy, ww, hh);
+    scrollbar_.position(scrollbar_.x() + dx, scrollbar_.y() + dy);
+    hscrollbar_.position(hscrollbar_.x() + dx, hscrollbar_.y() + dy);
+    return;
+  }
+
   Fl_Widget::resize(xx, yy, ww, hh);
 
   int scrollsize = scrollbar_size_ ? scrollbar_size_ : Fl::scrollbar_size();
@@ -197,6 +197,11 @@ void Fl_RGB_Image::uncache() {
     mask_ = 0;
   }
 #endif
+
+  if (surface_) {
+    cairo_surface_destroy((cairo_surface_t*)surface_);
+    surface_ = 0;
+  }
 }
 
 Fl_Image *Fl_RGB_Image::copy(int W, int H) {
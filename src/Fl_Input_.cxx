@@ -45,6 +45,8 @@ const int secret_char = 0x2022; // bullet to hide secret input
 static int l_secret;
 
 extern void fl_draw(const char*, int, float, float);
+extern void fl_shortcut_register(Fl_Widget*, int);	// in fl_shortcut.cxx
+extern void fl_shortcut_register_label(Fl_Widget*, int);
 
 ////////////////////////////////////////////////////////////////
 
@@ -1070,9 +1072,15 @@ Fl_Input_::Fl_Input_(int X, int Y, int W, int H, const char* l)
   maximum_size_ = 32767;
   shortcut_ = 0;
   set_flag(SHORTCUT_LABEL);
+  fl_shortcut_register_label(this, 1);
   tab_nav(1);
 }
 
+void Fl_Input_::shortcut(int s) {
+  shortcut_ = s;
+  fl_shortcut_register(this, s);
+}
+
 /**
  Copies the value from a possibly static entry into the internal buffer.
 
@@ -37,6 +37,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+extern void fl_shortcut_register_label(Fl_Widget*, int);	// in fl_shortcut.cxx
+extern void fl_shortcut_menu_changed(Fl_Menu_*);
+
 #define SAFE_STRCAT(s) { len += strlen(s); if ( len >= namelen ) { *name='\0'; return(-2); } else strcat(name,(s)); }
 
 /** Get the menu 'pathname' for the specified menuitem.
@@ -307,6 +310,7 @@ void Fl_Menu_Item::setonly() {
 Fl_Menu_::Fl_Menu_(int X,int Y,int W,int H,const char* l)
 : Fl_Widget(X,Y,W,H,l) {
   set_flag(SHORTCUT_LABEL);
+  fl_shortcut_register_label(this, 1);
   box(FL_UP_BOX);
   when(FL_WHEN_RELEASE_ALWAYS);
   value_ = menu_ = 0;
@@ -339,6 +343,12 @@ int Fl_Menu_::size() const {
 void Fl_Menu_::menu(const Fl_Menu_Item* m) {
   clear();
   value_ = menu_ = (Fl_Menu_Item*)m;
+  fl_shortcut_menu_changed(this);
+}
+
+void Fl_Menu_::shortcut(int i, int s) {
+  menu_[i].shortcut(s);
+  fl_shortcut_menu_changed(this);
 }
 
 // this version is ok with new Fl_Menu_add code with fl_menu_array_owner:
@@ -386,6 +396,7 @@ void Fl_Menu_::clear() {
     menu_ = 0;
     value_ = 0;
     alloc = 0;
+    fl_shortcut_menu_changed(this);
   }
 }
 
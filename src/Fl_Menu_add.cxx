@@ -39,6 +39,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+extern void fl_shortcut_menu_changed(Fl_Menu_*);	// in fl_shortcut.cxx
+
 // If the array is this, we will double-reallocate as necessary:
 static Fl_Menu_Item* local_array = 0;
 static int local_array_alloc = 0; // number allocated
@@ -407,6 +409,7 @@ int Fl_Menu_::insert(
   int value_offset = value_-menu_;
   menu_ = local_array; // in case it reallocated it
   if (value_) value_ = menu_+value_offset;
+  fl_shortcut_menu_changed(this);
   return r;
 }
 
@@ -463,6 +466,7 @@ void Fl_Menu_::replace(int i, const char *str) {
     str = strdup(str);
   }
   menu_[i].text = str;
+  fl_shortcut_menu_changed(this);
 }
 
 
@@ -489,6 +493,7 @@ void Fl_Menu_::remove(int i) {
   }
   // MRS: "n" is the menu size(), which includes the trailing NULL entry...
   memmove(item, next_item, (menu_+n-next_item)*sizeof(Fl_Menu_Item));
+  fl_shortcut_menu_changed(this);
 }
 
 //
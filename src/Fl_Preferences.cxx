@@ -960,6 +960,16 @@ Fl_Preferences::Name::~Name() {
 
 int Fl_Preferences::Node::lastEntrySet = -1;
 
+// FNV-1a hash of entry and group names
+static unsigned hashName( const char *name, int len ) {
+  unsigned h = 2166136261u;
+  for ( int i = 0; i < len; i++ ) {
+    h ^= (unsigned char)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
 // recursively create a path in the file system
 static char makePath( const char *path ) {
   if (access(path, 0)) {
@@ -1193,14 +1203,46 @@ int Fl_Preferences::RootNode::write() {
   if (!filename_)   // RUNTIME preferences
     return -1; 
   fl_make_path_for_file(filename_);
-  FILE *f = fl_fopen( filename_, "wb" );
-  if ( !f )
+  // write a temporary file and rename it when it is complete, so that a
+  // crash or a full disk never leaves a truncated preferences file behind
+  char *target = filename_;
+#if !defined(WIN32) || defined(__CYGWIN__)
+  // replace the file a symbolic link points to, not the link itself
+  char *resolved = realpath( filename_, 0 );
+  if ( resolved ) target = resolved;
+#endif
+  int len = strlen( target );
+  char *tmpname = (char*)malloc( len+5 );
+  memcpy( tmpname, target, len );
+  strcpy( tmpname+len, ".tmp" );
+  FILE *f = fl_fopen( tmpname, "wb" );
+  if ( !f ) {
+    free( tmpname );
+    if ( target != filename_ ) free( target );
     return -1; 
+  }
+#if !defined(WIN32) || defined(__CYGWIN__)
+  // keep the permissions of the file being replaced
+  struct stat st;
+  if ( stat( target, &st ) == 0 ) fchmod( fileno( f ), st.st_mode & 07777 );
+#endif
   fprintf( f, "; FLTK preferences file format 1.0\n" );
   fprintf( f, "; vendor: %s\n", vendor_ );
   fprintf( f, "; application: %s\n", application_ );
   prefs_->node->write( f );
-  fclose( f );
+  int err = ( fflush( f ) != 0 );
+#if !defined(WIN32) || defined(__CYGWIN__)
+  if ( !err && fsync( fileno( f ) ) ) err = 1;
+#endif
+  if ( fclose( f ) ) err = 1;
+#if defined(WIN32) && !defined(__CYGWIN__)
+  if ( !err ) fl_unlink( target );	// rename() does not replace files here
+#endif
+  if ( !err && fl_rename( tmpname, target ) ) err = 1;
+  if ( err ) fl_unlink( tmpname );
+  free( tmpname );
+  if ( target != filename_ ) free( target );
+  if ( err ) return -1;
 #if !(defined(__APPLE__) || defined(WIN32))
   // unix: make sure that system prefs are user-readable
   if (strncmp(filename_, "/etc/fltk/", 10) == 0) {
@@ -1252,6 +1294,10 @@ Fl_Preferences::Node::Node( const char *path ) {
   indexed_ = 0;
   index_ = 0;
   nIndex_ = NIndex_ = 0;
+  entryHash_ = 0;
+  NEntryHash_ = 0;
+  childHash_ = 0;
+  nChildHash_ = NChildHash_ = 0;
 }
 
 void Fl_Preferences::Node::deleteAllChildren() {
@@ -1263,6 +1309,7 @@ void Fl_Preferences::Node::deleteAllChildren() {
   child_ = 0L;
   dirty_ = 1;
   updateIndex();
+  unhashChildren();
 }
 
 void Fl_Preferences::Node::deleteAllEntries() {
@@ -1282,6 +1329,7 @@ void Fl_Preferences::Node::deleteAllEntries() {
     nEntry_ = 0;
     NEntry_ = 0;
   }
+  unhashEntries();
   dirty_ = 1;
 }
 
@@ -1290,6 +1338,8 @@ Fl_Preferences::Node::~Node() {
   deleteAllChildren();
   deleteAllEntries();
   deleteIndex();
+  unhashEntries();
+  unhashChildren();
   if ( path_ ) {
     free( path_ );
     path_ = 0L;
@@ -1298,19 +1348,20 @@ Fl_Preferences::Node::~Node() {
   parent_ = 0L;
 }
 
-// recursively check if any entry is dirty (was changed after loading a fresh prefs file)
+// check if any entry of this node, its neighbors or their children is dirty
+// (was changed after loading a fresh prefs file)
 char Fl_Preferences::Node::dirty() {
-  if ( dirty_ ) return 1;
-  if ( next_ && next_->dirty() ) return 1;
-  if ( child_ && child_->dirty() ) return 1;
+  for ( Node *nd = this; nd; nd = nd->next_ ) {
+    if ( nd->dirty_ ) return 1;
+    if ( nd->child_ && nd->child_->dirty() ) return 1;
+  }
   return 0;
 }
 
-// write this node (recursively from the last neighbor back to this)
+// write this node
 // write all entries
-// write all children
+// write all children, oldest first
 int Fl_Preferences::Node::write( FILE *f ) {
-  if ( next_ ) next_->write( f );
   fprintf( f, "\n[%s]\n\n", path_ );
   for ( int i = 0; i < nEntry_; i++ ) {
     char *src = entry_[i].value;
@@ -1334,7 +1385,9 @@ int Fl_Preferences::Node::write( FILE *f ) {
     else
       fprintf( f, "%s\n", entry_[i].name );
   }
-  if ( child_ ) child_->write( f );
+  createIndex();
+  for ( int i = 0; i < nIndex_; i++ )
+    index_[i]->write( f );
   dirty_ = 0;
   return 0;
 }
@@ -1347,6 +1400,8 @@ void Fl_Preferences::Node::setParent( Node *pn ) {
   sprintf( nameBuffer, "%s/%s", pn->path_, path_ );
   free( path_ );
   path_ = strdup( nameBuffer );
+  pn->updateIndex();
+  pn->hashChild( this );
 }
 
 // find the corresponding root node
@@ -1374,18 +1429,17 @@ Fl_Preferences::Node *Fl_Preferences::Node::addChild( const char *path ) {
 // create and set, or change an entry within this node
 void Fl_Preferences::Node::set( const char *name, const char *value )
 {
-  for ( int i=0; i<nEntry_; i++ ) {
-    if ( strcmp( name, entry_[i].name ) == 0 ) {
-      if ( !value ) return; // annotation
-      if ( strcmp( value, entry_[i].value ) != 0 ) {
-	if ( entry_[i].value )
-	  free( entry_[i].value );
-	entry_[i].value = strdup( value );
-	dirty_ = 1;
-      }
-      lastEntrySet = i;
-      return;
+  int i = getEntry( name );
+  if ( i >= 0 ) {
+    if ( !value ) return; // annotation
+    if ( strcmp( value, entry_[i].value ) != 0 ) {
+      if ( entry_[i].value )
+	free( entry_[i].value );
+      entry_[i].value = strdup( value );
+      dirty_ = 1;
     }
+    lastEntrySet = i;
+    return;
   }
   if ( NEntry_==nEntry_ ) {
     NEntry_ = NEntry_ ? NEntry_*2 : 10;
@@ -1396,6 +1450,15 @@ void Fl_Preferences::Node::set( const char *name, const char *value )
   lastEntrySet = nEntry_;
   nEntry_++;
   dirty_ = 1;
+  if ( entryHash_ ) {
+    if ( nEntry_*2 > NEntryHash_ ) {
+      unhashEntries();		// rebuilt larger by the next getEntry()
+    } else {
+      unsigned m = NEntryHash_-1, h;
+      for ( h = hashName( name, strlen( name ) ) & m; entryHash_[h]; h = (h+1) & m ) ;
+      entryHash_[h] = nEntry_;
+    }
+  }
 }
 
 // create or set a value (or annotation) from a single line in the file buffer
@@ -1438,11 +1501,21 @@ const char *Fl_Preferences::Node::get( const char *name ) {
 }
 
 // find the index of an entry, returns -1 if no such entry
+// - groups with more than a few entries look the name up in a hash table
 int Fl_Preferences::Node::getEntry( const char *name ) {
-  for ( int i=0; i<nEntry_; i++ ) {
-    if ( strcmp( name, entry_[i].name ) == 0 ) {
-      return i;
+  if ( nEntry_ < 8 ) {
+    for ( int i=0; i<nEntry_; i++ ) {
+      if ( strcmp( name, entry_[i].name ) == 0 ) {
+	return i;
+      }
     }
+    return -1;
+  }
+  if ( !entryHash_ ) hashEntries();
+  unsigned m = NEntryHash_-1, h;
+  for ( h = hashName( name, strlen( name ) ) & m; entryHash_[h]; h = (h+1) & m ) {
+    if ( strcmp( name, entry_[ entryHash_[h]-1 ].name ) == 0 )
+      return entryHash_[h]-1;
   }
   return -1;
 }
@@ -1451,8 +1524,11 @@ int Fl_Preferences::Node::getEntry( const char *name ) {
 char Fl_Preferences::Node::deleteEntry( const char *name ) {
   int ix = getEntry( name );
   if ( ix == -1 ) return 0;
+  free( entry_[ix].name );
+  if ( entry_[ix].value ) free( entry_[ix].value );
   memmove( entry_+ix, entry_+ix+1, (nEntry_-ix-1) * sizeof(Entry) );
   nEntry_--;
+  unhashEntries();
   dirty_ = 1;
   return 1;
 }
@@ -1466,13 +1542,10 @@ Fl_Preferences::Node *Fl_Preferences::Node::find( const char *path ) {
     if ( path[ len ] == 0 )
       return this;
     if ( path[ len ] == '/' ) {
-      Node *nd;
-      for ( nd = child_; nd; nd = nd->next_ ) {
-	Node *nn = nd->find( path );
-	if ( nn ) return nn;
-      }
       const char *s = path+len+1;
       const char *e = strchr( s, '/' );
+      Node *nd = childNamed( s, e ? (int)(e-s) : (int)strlen(s) );
+      if ( nd ) return nd->find( path );
       if (e) strlcpy( nameBuffer, s, e-s+1 );
       else strlcpy( nameBuffer, s, sizeof(nameBuffer));
       nd = new Node( nameBuffer );
@@ -1512,11 +1585,10 @@ Fl_Preferences::Node *Fl_Preferences::Node::search( const char *path, int offset
     if ( len > 0 && path[ len ] == 0 )
       return this;
     if ( len <= 0 || path[ len ] == '/' ) {
-      for ( Node *nd = child_; nd; nd = nd->next_ ) {
-	Node *nn = nd->search( path, offset );
-	if ( nn ) return nn;
-      }
-      return 0;
+      const char *s = len <= 0 ? path : path+len+1;
+      const char *e = strchr( s, '/' );
+      Node *nd = childNamed( s, e ? (int)(e-s) : (int)strlen(s) );
+      return nd ? nd->search( path, offset ) : 0;
     }
   }
   return 0;
@@ -1588,6 +1660,7 @@ char Fl_Preferences::Node::remove() {
     }
     parent()->dirty_ = 1;
     parent()->updateIndex();
+    parent()->unhashChildren();
   }
   delete this;
   return ( nd != 0 );
@@ -1620,6 +1693,83 @@ void Fl_Preferences::Node::deleteIndex() {
   indexed_ = 0;
 }
 
+// build the hash table of entry names, keeping the first of equal names
+void Fl_Preferences::Node::hashEntries() {
+  unhashEntries();
+  for ( NEntryHash_ = 16; NEntryHash_ < nEntry_*2+2; NEntryHash_ *= 2 ) ;
+  entryHash_ = (int*)calloc( NEntryHash_, sizeof(int) );
+  unsigned m = NEntryHash_-1, h;
+  for ( int i = 0; i < nEntry_; i++ ) {
+    for ( h = hashName( entry_[i].name, strlen( entry_[i].name ) ) & m; entryHash_[h]; h = (h+1) & m )
+      if ( strcmp( entry_[i].name, entry_[ entryHash_[h]-1 ].name ) == 0 ) break;
+    if ( !entryHash_[h] ) entryHash_[h] = i+1;
+  }
+}
+
+void Fl_Preferences::Node::unhashEntries() {
+  if ( entryHash_ ) free( entryHash_ );
+  entryHash_ = 0;
+  NEntryHash_ = 0;
+}
+
+// build the hash table of child names
+void Fl_Preferences::Node::hashChildren( int n ) {
+  unhashChildren();
+  for ( NChildHash_ = 16; NChildHash_ < n*2+2; NChildHash_ *= 2 ) ;
+  childHash_ = (Node**)calloc( NChildHash_, sizeof(Node*) );
+  createIndex();
+  for ( int i = 0; i < nIndex_; i++ )	// oldest first, so the newest of equal names wins
+    hashChild( index_[i] );
+}
+
+// add a new child to the hash table, if there is one
+void Fl_Preferences::Node::hashChild( Node *nd ) {
+  if ( !childHash_ ) return;
+  if ( (nChildHash_+1)*2 > NChildHash_ ) {
+    unhashChildren();		// rebuilt larger by the next childNamed()
+    return;
+  }
+  const char *name = nd->name();
+  unsigned m = NChildHash_-1, h;
+  for ( h = hashName( name, strlen( name ) ) & m; childHash_[h]; h = (h+1) & m ) {
+    if ( strcmp( name, childHash_[h]->name() ) == 0 ) {
+      childHash_[h] = nd;
+      return;
+    }
+  }
+  childHash_[h] = nd;
+  nChildHash_++;
+}
+
+void Fl_Preferences::Node::unhashChildren() {
+  if ( childHash_ ) free( childHash_ );
+  childHash_ = 0;
+  nChildHash_ = NChildHash_ = 0;
+}
+
+// find the newest child node with the given name, or return 0
+// - nodes with more than a few children look the name up in a hash table
+Fl_Preferences::Node *Fl_Preferences::Node::childNamed( const char *name, int len ) {
+  if ( !childHash_ ) {
+    int n = 0;
+    for ( Node *nd = child_; nd; nd = nd->next_ ) n++;
+    if ( n < 8 ) {
+      for ( Node *nd = child_; nd; nd = nd->next_ ) {
+	const char *nm = nd->name();
+	if ( strncmp( nm, name, len ) == 0 && nm[len] == 0 ) return nd;
+      }
+      return 0;
+    }
+    hashChildren( n );
+  }
+  unsigned m = NChildHash_-1, h;
+  for ( h = hashName( name, len ) & m; childHash_[h]; h = (h+1) & m ) {
+    const char *nm = childHash_[h]->name();
+    if ( strncmp( nm, name, len ) == 0 && nm[len] == 0 ) return childHash_[h];
+  }
+  return 0;
+}
+
 /**
  * \brief Create a plugin.
  *
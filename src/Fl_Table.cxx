@@ -64,38 +64,109 @@ void Fl_Table::col_position(int col) {
   _col_position = col;	// HACK: override what table_scrolled() came up with
 }
 
-// Find scroll position of a row (in pixels)
-long Fl_Table::row_scroll_position(int row) {
-  int startrow = 0;
-  long scroll = 0; 
-  // OPTIMIZATION: 
-  //     Attempt to use precomputed row scroll position
-  //
-  if ( toprow_scrollpos != -1 && row >= toprow ) {
-    scroll = toprow_scrollpos;
-    startrow = toprow;
+// Recompute the running totals from the sizes, in linear time
+void Fl_Table::SizeVector::rebuild() {
+  unsigned int t;
+  sums = (long*)realloc(sums, (_size + 1) * sizeof(long));
+  sums[0] = 0;
+  for ( t=1; t<=_size; t++ ) sums[t] = arr[t-1];
+  for ( t=1; t<=_size; t++ ) {
+    unsigned int up = t + (t & (0-t));
+    if ( up <= _size ) sums[up] += sums[t];
+  }
+  for ( top=1; (unsigned int)top*2 <= _size; top *= 2 ) { }
+  if ( _size == 0 ) top = 0;
+}
+
+// Stop being uniform: keep every size
+void Fl_Table::SizeVector::split() {
+  arr = (int*)malloc((_size ? _size : 1) * sizeof(int));
+  for ( unsigned int t=0; t<_size; t++ ) arr[t] = _uniform;
+  rebuild();
+}
+
+// Change the number of entries, setting new ones to 'fill'
+void Fl_Table::SizeVector::size(unsigned int count, int fill) {
+  if ( count == 0 ) {
+    if ( arr ) { free(arr); arr = NULL; }
+    if ( sums ) { free(sums); sums = NULL; }
+    _size = 0;
+    return;
+  }
+  if ( ! arr ) {
+    if ( _size == 0 ) _uniform = fill;
+    if ( count <= _size || fill == _uniform ) {	// still uniform?
+      _size = count;
+      return;
+    }
+    split();
   }
-  for ( int t=startrow; t<row; t++ ) {
-    scroll += row_height(t);
+  unsigned int now_size = _size;
+  arr = (int*)realloc(arr, count * sizeof(int));
+  while ( now_size < count ) {
+    arr[now_size++] = fill;
   }
-  return(scroll);
+  _size = count;
+  rebuild();
 }
 
-// Find scroll position of a column (in pixels)
-long Fl_Table::col_scroll_position(int col) {
-  int startcol = 0;
-  long scroll = 0;
-  // OPTIMIZATION: 
-  //     Attempt to use precomputed row scroll position
-  //
-  if ( leftcol_scrollpos != -1 && col >= leftcol ) {
-    scroll = leftcol_scrollpos;
-    startcol = leftcol;
+// Set the size of entry 'x'
+void Fl_Table::SizeVector::set(int x, int val) {
+  if ( ! arr ) {
+    if ( val == _uniform ) return;
+    split();
+  }
+  long diff = (long)val - arr[x];
+  arr[x] = val;
+  for ( unsigned int t=x+1; t<=_size; t += t & (0-t) ) {
+    sums[t] += diff;
   }
-  for ( int t=startcol; t<col; t++ ) {
-    scroll += col_width(t);
+}
+
+// Total size of the first 'count' entries
+long Fl_Table::SizeVector::sum(int count) const {
+  if ( count <= 0 ) return(0);
+  if ( (unsigned int)count > _size ) count = _size;
+  if ( ! arr ) return((long)count * _uniform);
+  long total = 0;
+  for ( int t=count; t>0; t -= t & -t ) {
+    total += sums[t];
   }
-  return(scroll);
+  return(total);
+}
+
+// Find the entry that position 'pos' falls in.
+//    Returns the last entry whose start is at or before pos (or size()
+//    if pos is beyond the end), and its start in 'start'.
+//
+int Fl_Table::SizeVector::find(long pos, long &start) const {
+  if ( pos < 0 ) { start = 0; return(0); }
+  if ( ! arr ) {
+    long t = ( _uniform > 0 ) ? pos / _uniform : (long)_size;
+    if ( t > (long)_size ) t = _size;
+    start = t * _uniform;
+    return((int)t);
+  }
+  int idx = 0;
+  long total = 0;
+  for ( int step=top; step; step >>= 1 ) {
+    if ( (unsigned int)(idx + step) <= _size && total + sums[idx+step] <= pos ) {
+      idx += step;
+      total += sums[idx];
+    }
+  }
+  start = total;
+  return(idx);
+}
+
+// Find scroll position of a row (in pixels)
+long Fl_Table::row_scroll_position(int row) {
+  return(_rowheights.sum(row));
+}
+
+// Find scroll position of a column (in pixels)
+long Fl_Table::col_scroll_position(int col) {
+  return(_colwidths.sum(col));
 }
 
 // Ctor
@@ -174,13 +245,10 @@ void Fl_Table::row_height(int row, int height) {
     return;		// OPTIMIZATION: no change? avoid redraw
   }
   // Add row heights, even if none yet
-  int now_size = (int)_rowheights.size();
-  if ( row >= now_size ) {
-    _rowheights.size(row);
-    while (now_size < row)
-      _rowheights[now_size++] = height;
+  if ( row >= (int)_rowheights.size() ) {
+    _rowheights.size(row+1, height);
   }
-  _rowheights[row] = height;
+  _rowheights.set(row, height);
   table_resized();
   if ( row <= botrow ) {	// OPTIMIZATION: only redraw if onscreen or above screen
     redraw();
@@ -199,14 +267,10 @@ void Fl_Table::col_width(int col, int width)
     return;			// OPTIMIZATION: no change? avoid redraw
   }
   // Add column widths, even if none yet
-  int now_size = (int)_colwidths.size();
-  if ( col >= now_size ) {
-    _colwidths.size(col);
-    while (now_size < col) {
-      _colwidths[now_size++] = width;
-    }
+  if ( col >= (int)_colwidths.size() ) {
+    _colwidths.size(col+1, width);
   }
-  _colwidths[col] = width;
+  _colwidths.set(col, width);
   table_resized();
   if ( col <= rightcol ) {	// OPTIMIZATION: only redraw if onscreen or to the left
     redraw();
@@ -506,38 +570,29 @@ void Fl_Table::recalc_dimensions() {
 //    TODO: Assumes ti[xywh] has already been recalculated.
 //
 void Fl_Table::table_scrolled() {
-  // Find top row
-  int y, row, voff = vscrollbar->value();
-  for ( row=y=0; row < _rows; row++ ) {
-    y += row_height(row);
-    if ( y > voff ) { y -= row_height(row); break; }
-  }
+  long start;
+  // Find top row: the first row that ends below the scroll position
+  int voff = vscrollbar->value();
+  int row = _rowheights.find(voff, start);
+  if ( row >= _rows ) { row = _rows; start = row_scroll_position(_rows); }
   _row_position = toprow = ( row >= _rows ) ? (row - 1) : row;
-  toprow_scrollpos = y;		// OPTIMIZATION: save for later use 
-  // Find bottom row
+  toprow_scrollpos = start;	// OPTIMIZATION: save for later use 
+  // Find bottom row: the first row that reaches the bottom edge
   voff = vscrollbar->value() + tih;
-  for ( ; row < _rows; row++ ) {
-    y += row_height(row);
-    if ( y >= voff ) { break; }
-  }
-  botrow = ( row >= _rows ) ? (row - 1) : row; 
+  int bot = _rowheights.find(voff - 1, start);
+  if ( bot < row ) bot = row;
+  botrow = ( bot >= _rows ) ? (_rows - 1) : bot; 
   // Left column
-  int x, col, hoff = hscrollbar->value();
-  for ( col=x=0; col < _cols; col++ ) {
-    x += col_width(col);
-    if ( x > hoff ) { x -= col_width(col); break; }
-  }
+  int hoff = hscrollbar->value();
+  int col = _colwidths.find(hoff, start);
+  if ( col >= _cols ) { col = _cols; start = col_scroll_position(_cols); }
   _col_position = leftcol = ( col >= _cols ) ? (col - 1) : col;
-  leftcol_scrollpos = x;	// OPTIMIZATION: save for later use 
+  leftcol_scrollpos = start;	// OPTIMIZATION: save for later use 
   // Right column
-  //    Work with data left over from leftcol calculation
-  //
   hoff = hscrollbar->value() + tiw;
-  for ( ; col < _cols; col++ ) {
-    x += col_width(col);
-    if ( x >= hoff ) { break; }
-  }
-  rightcol = ( col >= _cols ) ? (col - 1) : col; 
+  int right = _colwidths.find(hoff - 1, start);
+  if ( right < col ) right = col;
+  rightcol = ( right >= _cols ) ? (_cols - 1) : right; 
   // First tell children to scroll
   draw_cell(CONTEXT_RC_RESIZE, 0,0,0,0,0,0);
 }
@@ -600,11 +655,7 @@ void Fl_Table::rows(int val) {
   _rows = val;
   {
     int default_h = ( _rowheights.size() > 0 ) ? _rowheights.back() : 25;
-    int now_size = _rowheights.size();
-    _rowheights.size(val);			// enlarge or shrink as needed
-    while ( now_size < val ) {
-      _rowheights[now_size++] = default_h;	// fill new
-    }
+    _rowheights.size(val, default_h);		// enlarge or shrink as needed
   }
   table_resized();
   
@@ -621,11 +672,7 @@ void Fl_Table::cols(int val) {
   _cols = val;
   {
     int default_w = ( _colwidths.size() > 0 ) ? _colwidths[_colwidths.size()-1] : 80;
-    int now_size = _colwidths.size();
-    _colwidths.size(val);			// enlarge or shrink as needed
-    while ( now_size < val ) {
-      _colwidths[now_size++] = default_w;	// fill new
-    }
+    _colwidths.size(val, default_w);		// enlarge or shrink as needed
   }
   table_resized();
   redraw();
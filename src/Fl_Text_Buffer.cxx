@@ -30,9 +30,18 @@
 #include <FL/fl_utf8.h>
 #include "flstring.h"
 #include <ctype.h>
+#include <limits.h>
+#ifndef WIN32
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif // !WIN32
 #include <FL/Fl.H>
 #include <FL/Fl_Text_Buffer.H>
 #include <FL/fl_ask.H>
+#include "Fl_Text_Rope.H"
 
 
 /*
@@ -118,6 +127,10 @@ Fl_Text_Buffer::Fl_Text_Buffer(int requestedSize, int preferredGapSize)
   mBuf = (char *) malloc(requestedSize + mPreferredGapSize);
   mGapStart = 0;
   mGapEnd = mPreferredGapSize;
+  mRope = NULL;
+  mMaps = NULL;
+  mMapFd = -1;
+  mMapSize = 0;
   mTabDist = 8;
   mPrimary.mSelected = 0;
   mPrimary.mStart = mPrimary.mEnd = 0;
@@ -144,6 +157,8 @@ Fl_Text_Buffer::Fl_Text_Buffer(int requestedSize, int preferredGapSize)
 Fl_Text_Buffer::~Fl_Text_Buffer()
 {
   free(mBuf);
+  delete mRope;
+  unmap(1);
   if (mNModifyProcs != 0) {
     delete[]mModifyProcs;
     delete[]mCbArgs;
@@ -161,13 +176,71 @@ Fl_Text_Buffer::~Fl_Text_Buffer()
  */
 char *Fl_Text_Buffer::text() const {
   char *t = (char *) malloc(mLength + 1);
-  memcpy(t, mBuf, mGapStart);
-  memcpy(t+mGapStart, mBuf+mGapEnd, mLength - mGapStart);
+  copy_out(0, mLength, t);
   t[mLength] = '\0';
   return t;
 } 
 
 
+/*
+ Copy a range of text out of the gap buffer or the piece table.
+ */
+void Fl_Text_Buffer::copy_out(int start, int end, char *dest) const {
+  if (mRope) {
+    mRope->copy_out(start, end, dest);
+  } else if (end <= mGapStart) {
+    memcpy(dest, mBuf + start, end - start);
+  } else if (start >= mGapStart) {
+    memcpy(dest, mBuf + start + (mGapEnd - mGapStart), end - start);
+  } else {
+    int part1Length = mGapStart - start;
+    memcpy(dest, mBuf + start, part1Length);
+    memcpy(dest + part1Length, mBuf + mGapEnd, end - start - part1Length);
+  }
+}
+
+
+/*
+ Return the address of a position and the number of contiguous bytes there.
+ */
+const char *Fl_Text_Buffer::span(int pos, int *len) const {
+  if (mRope)
+    return mRope->span(pos, len);
+  if (pos < mGapStart) {
+    if (len) *len = mGapStart - pos;
+    return mBuf + pos;
+  }
+  if (len) *len = mLength - pos;
+  return mBuf + pos + mGapEnd - mGapStart;
+}
+
+
+/*
+ Switch between the gap buffer and the piece table.
+ */
+void Fl_Text_Buffer::piece_table(int on)
+{
+  if (!on == !mRope)
+    return;
+  if (on) {
+    mRope = new Fl_Text_Rope;
+    mRope->insert(0, mBuf, mGapStart);
+    mRope->insert(mGapStart, mBuf + mGapEnd, mLength - mGapStart);
+    free((void *) mBuf);
+    mBuf = NULL;
+    mGapStart = mGapEnd = 0;
+  } else {
+    mBuf = (char *) malloc(mLength + mPreferredGapSize);
+    mRope->copy_out(0, mLength, mBuf);
+    mGapStart = mLength;
+    mGapEnd = mGapStart + mPreferredGapSize;
+    delete mRope;
+    mRope = NULL;
+    unmap(0);
+  }
+}
+
+
 /*
  Set the text buffer to a new string.
  */
@@ -180,15 +253,21 @@ void Fl_Text_Buffer::text(const char *t)
   /* Save information for redisplay, and get rid of the old buffer */
   const char *deletedText = text();
   int deletedLength = mLength;
-  free((void *) mBuf);
-  
-  /* Start a new buffer with a gap of mPreferredGapSize at the end */
   int insertedLength = strlen(t);
-  mBuf = (char *) malloc(insertedLength + mPreferredGapSize);
   mLength = insertedLength;
-  mGapStart = insertedLength;
-  mGapEnd = mGapStart + mPreferredGapSize;
-  memcpy(mBuf, t, insertedLength);
+  
+  if (mRope) {
+    mRope->clear();
+    mRope->insert(0, t, insertedLength);
+  } else {
+    /* Start a new buffer with a gap of mPreferredGapSize at the end */
+    free((void *) mBuf);
+    mBuf = (char *) malloc(insertedLength + mPreferredGapSize);
+    mGapStart = insertedLength;
+    mGapEnd = mGapStart + mPreferredGapSize;
+    memcpy(mBuf, t, insertedLength);
+  }
+  unmap(1);
   
   /* Zero all of the existing selections */
   update_selections(0, deletedLength, 0);
@@ -227,15 +306,7 @@ char *Fl_Text_Buffer::text_range(int start, int end) const {
   s = (char *) malloc(copiedLength + 1);
   
   /* Copy the text from the buffer to the returned string */
-  if (end <= mGapStart) {
-    memcpy(s, mBuf + start, copiedLength);
-  } else if (start >= mGapStart) {
-    memcpy(s, mBuf + start + (mGapEnd - mGapStart), copiedLength);
-  } else {
-    int part1Length = mGapStart - start;
-    memcpy(s, mBuf + start, part1Length);
-    memcpy(s + part1Length, mBuf + mGapEnd, copiedLength - part1Length);
-  }
+  copy_out(start, end, s);
   s[copiedLength] = '\0';
   return s;
 }
@@ -375,6 +446,15 @@ void Fl_Text_Buffer::copy(Fl_Text_Buffer * fromBuf, int fromStart,
   
   int copiedLength = fromEnd - fromStart;
   
+  if (mRope) {
+    char *t = fromBuf->text_range(fromStart, fromEnd);
+    mRope->insert(toPos, t, copiedLength);
+    free(t);
+    mLength += copiedLength;
+    update_selections(toPos, 0, copiedLength);
+    return;
+  }
+  
   /* Prepare the buffer to receive the new text.  If the new text fits in
    the current buffer, just move the gap (if necessary) to where
    the text should be inserted.  If the new text is too large, reallocate
@@ -386,18 +466,7 @@ void Fl_Text_Buffer::copy(Fl_Text_Buffer * fromBuf, int fromStart,
     move_gap(toPos);
   
   /* Insert the new text (toPos now corresponds to the start of the gap) */
-  if (fromEnd <= fromBuf->mGapStart) {
-    memcpy(&mBuf[toPos], &fromBuf->mBuf[fromStart], copiedLength);
-  } else if (fromStart >= fromBuf->mGapStart) {
-    memcpy(&mBuf[toPos],
-	   &fromBuf->mBuf[fromStart + (fromBuf->mGapEnd - fromBuf->mGapStart)],
-	   copiedLength);
-  } else {
-    int part1Length = fromBuf->mGapStart - fromStart;
-    memcpy(&mBuf[toPos], &fromBuf->mBuf[fromStart], part1Length);
-    memcpy(&mBuf[toPos + part1Length],
-	   &fromBuf->mBuf[fromBuf->mGapEnd], copiedLength - part1Length);
-  }
+  fromBuf->copy_out(fromStart, fromEnd, &mBuf[toPos]);
   mGapStart += copiedLength;
   mLength += copiedLength;
   update_selections(toPos, 0, copiedLength);
@@ -912,6 +981,12 @@ int Fl_Text_Buffer::count_lines(int startPos, int endPos) const {
   IS_UTF8_ALIGNED2(this, (startPos))
   IS_UTF8_ALIGNED2(this, (endPos))
   
+  if (mRope) {
+    if (endPos > mLength) endPos = mLength;
+    if (endPos <= startPos) return 0;
+    return mRope->newlines_before(endPos) - mRope->newlines_before(startPos);
+  }
+  
   int gapLen = mGapEnd - mGapStart;
   int lineCount = 0;
   
@@ -945,6 +1020,11 @@ int Fl_Text_Buffer::skip_lines(int startPos, int nLines)
   if (nLines == 0)
     return startPos;
   
+  if (mRope) {
+    if (startPos >= mLength) return mLength;
+    return mRope->line_position(mRope->newlines_before(startPos) + nLines);
+  }
+  
   int gapLen = mGapEnd - mGapStart;
   int pos = startPos;
   int lineCount = 0;
@@ -984,6 +1064,12 @@ int Fl_Text_Buffer::rewind_lines(int startPos, int nLines)
   if (pos <= 0)
     return 0;
   
+  if (mRope) {
+    // the newline nLines+1 back from pos (inclusive) ends the wanted line
+    int line = mRope->newlines_before(pos + 1) - nLines;
+    return line > 0 ? mRope->line_position(line) : 0;
+  }
+  
   int gapLen = mGapEnd - mGapStart;
   int lineCount = -1;
   while (pos >= mGapStart) {
@@ -1128,19 +1214,23 @@ int Fl_Text_Buffer::insert_(int pos, const char *text)
   
   int insertedLength = strlen(text);
   
-  /* Prepare the buffer to receive the new text.  If the new text fits in
-   the current buffer, just move the gap (if necessary) to where
-   the text should be inserted.  If the new text is too large, reallocate
-   the buffer with a gap large enough to accomodate the new text and a
-   gap of mPreferredGapSize */
-  if (insertedLength > mGapEnd - mGapStart)
-    reallocate_with_gap(pos, insertedLength + mPreferredGapSize);
-  else if (pos != mGapStart)
-    move_gap(pos);
-  
-  /* Insert the new text (pos now corresponds to the start of the gap) */
-  memcpy(&mBuf[pos], text, insertedLength);
-  mGapStart += insertedLength;
+  if (mRope) {
+    mRope->insert(pos, text, insertedLength);
+  } else {
+    /* Prepare the buffer to receive the new text.  If the new text fits in
+     the current buffer, just move the gap (if necessary) to where
+     the text should be inserted.  If the new text is too large, reallocate
+     the buffer with a gap large enough to accomodate the new text and a
+     gap of mPreferredGapSize */
+    if (insertedLength > mGapEnd - mGapStart)
+      reallocate_with_gap(pos, insertedLength + mPreferredGapSize);
+    else if (pos != mGapStart)
+      move_gap(pos);
+    
+    /* Insert the new text (pos now corresponds to the start of the gap) */
+    memcpy(&mBuf[pos], text, insertedLength);
+    mGapStart += insertedLength;
+  }
   mLength += insertedLength;
   update_selections(pos, 0, insertedLength);
   
@@ -1183,6 +1273,15 @@ void Fl_Text_Buffer::remove_(int start, int end)
     undowidget = this;
   }
   
+  if (mRope) {
+    if (mCanUndo)
+      mRope->copy_out(start, end, undobuffer);
+    mRope->remove(start, end);
+    mLength -= end - start;
+    update_selections(start, end - start, 0);
+    return;
+  }
+  
   if (start > mGapStart) {
     if (mCanUndo)
       memcpy(undobuffer, mBuf + (mGapEnd - mGapStart) + start,
@@ -1483,6 +1582,16 @@ int Fl_Text_Buffer::findchar_forward(int startPos, unsigned searchChar,
   if (startPos<0)
     startPos = 0;
   
+  if (mRope && searchChar == '\n') {
+    int line = mRope->newlines_before(startPos) + 1;
+    if (line > mRope->lines()) {
+      *foundPos = mLength;
+      return 0;
+    }
+    *foundPos = mRope->line_position(line) - 1;
+    return 1;
+  }
+  
   for ( ; startPos<mLength; startPos = next_char(startPos)) {
     if (searchChar == char_at(startPos)) {
       *foundPos = startPos;
@@ -1509,6 +1618,12 @@ int Fl_Text_Buffer::findchar_backward(int startPos, unsigned int searchChar,
   if (startPos > mLength)
     startPos = mLength;
   
+  if (mRope && searchChar == '\n') {
+    int line = mRope->newlines_before(startPos);
+    *foundPos = line ? mRope->line_position(line) - 1 : 0;
+    return line != 0;
+  }
+  
   for (startPos = prev_char(startPos); startPos>=0; startPos = prev_char(startPos)) {
     if (searchChar == char_at(startPos)) {
       *foundPos = startPos;
@@ -1660,6 +1775,8 @@ const char *Fl_Text_Buffer::file_encoding_warning_message =
   FILE *fp;
   if (!(fp = fl_fopen(file, "r")))
     return 1;
+  if (!mLength)
+    unmap(1); // nothing refers to a mapped file any more
   char *buffer = new char[buflen + 1];  
   char *endline, line[100];
   int l;
@@ -1702,11 +1819,13 @@ int Fl_Text_Buffer::outputfile(const char *file,
   FILE *fp;
   if (!(fp = fl_fopen(file, "w")))
     return 1;
-  for (int n; (n = min(end - start, buflen)); start += n) {
-    const char *p = text_range(start, start + n);
-    int r = fwrite(p, 1, n, fp);
-    free((void *) p);
-    if (r != n)
+  for (int n; (n = min(end - start, buflen)) > 0; start += n) {
+    const char *p = span(start, &n);
+    if (n > end - start)
+      n = end - start;
+    if (!n)
+      break;
+    if ((int)fwrite(p, 1, n, fp) != n)
       break;
   }
   
@@ -1716,6 +1835,184 @@ int Fl_Text_Buffer::outputfile(const char *file,
 }
 
 
+/*
+ Part of a file mapped into memory by mapfile() or tailfile().
+ */
+struct Fl_Text_Mapping {
+  Fl_Text_Mapping *next;
+  void *addr;
+  size_t size;
+  off_t offset;                 // in the file
+};
+
+// appended text shorter than this is copied instead of mapped
+static const long MAP_MIN = 1024 * 1024;
+
+
+/*
+ Load a file by mapping it into memory.
+ */
+int Fl_Text_Buffer::mapfile(const char *file)
+{
+#ifdef WIN32
+  return loadfile(file);
+#else
+  int fd = fl_open(file, O_RDONLY);
+  if (fd < 0)
+    return 1;
+  drop_text();
+  unmap(1);
+  mMapFd = fd;
+  mMapSize = 0;
+  input_file_was_transcoded = 0;
+  return tailfile() < 0 ? 2 : 0;
+#endif // WIN32
+}
+
+
+/*
+ Append the text added to the mapped file since it was last looked at.
+ */
+int Fl_Text_Buffer::tailfile()
+{
+#ifdef WIN32
+  return -1;
+#else
+  struct stat st;
+  if (mMapFd < 0 || fstat(mMapFd, &st))
+    return -1;
+  if ((long)st.st_size < mMapSize) {
+    /* The file was truncated, and touching the pages past its new end
+     would raise SIGBUS. Put zero pages there in case anything still
+     looks at the old text, then load the file again from the start. */
+    long page = sysconf(_SC_PAGESIZE);
+    for (Fl_Text_Mapping *m = mMaps; m; m = m->next) {
+      long keep = (long)st.st_size - (long)m->offset;
+      keep = keep <= 0 ? 0 : (keep + page - 1) / page * page;
+      if (keep < (long)m->size)
+        mmap((char *)m->addr + keep, m->size - keep, PROT_READ,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    }
+    drop_text();
+    unmap(0);
+    mMapSize = 0;
+    return tailfile();
+  }
+  long n = (long)st.st_size - mMapSize;
+  if (n > INT_MAX - mLength)
+    n = INT_MAX - mLength;
+  if (n <= 0)
+    return 0;
+  
+  const char *text = NULL;
+  char *copy = NULL;
+  if (n >= MAP_MIN) {
+    long skip = mMapSize % sysconf(_SC_PAGESIZE);
+    void *addr = mmap(NULL, n + skip, PROT_READ, MAP_SHARED, mMapFd, mMapSize - skip);
+    if (addr != MAP_FAILED) {
+      Fl_Text_Mapping *m = new Fl_Text_Mapping;
+      m->next = mMaps;
+      m->addr = addr;
+      m->size = n + skip;
+      m->offset = mMapSize - skip;
+      mMaps = m;
+      text = (const char *)addr + skip;
+    }
+  }
+  if (!text) {
+    copy = (char *)malloc(n);
+    long got = 0;
+    while (got < n) {
+      ssize_t r = pread(mMapFd, copy + got, n - got, mMapSize + got);
+      if (r <= 0)
+        break;
+      got += r;
+    }
+    if (!got) {
+      free(copy);
+      return -1;
+    }
+    n = got;
+    text = copy;
+  }
+  
+  /* leave a character that is only partly written for the next call */
+  long c = n - 1;
+  while (c > 0 && n - c < 4 && (text[c] & 0xc0) == 0x80)
+    c--;
+  if (fl_utf8len1(text[c]) > n - c)
+    n = c;
+  
+  if (n > 0) {
+    piece_table(1);
+    int pos = mLength;
+    call_predelete_callbacks(pos, 0);
+    if (copy)
+      mRope->insert(pos, text, n);
+    else
+      mRope->reference(pos, text, n);
+    mLength += n;
+    mMapSize += n;
+    update_selections(pos, 0, n);
+    call_modify_callbacks(pos, 0, n, 0, NULL);
+  }
+  free(copy);
+  return n;
+#endif // WIN32
+}
+
+
+/*
+ Remove all the text without copying it, so that the pages of a mapped
+ file are not read just to be thrown away. The modify callbacks get a
+ NULL deletedText.
+ */
+void Fl_Text_Buffer::drop_text()
+{
+  int deletedLength = mLength;
+  if (mRope) {
+    mRope->clear();
+  } else {
+    free((void *) mBuf);
+    mBuf = (char *) malloc(mPreferredGapSize);
+    mGapStart = 0;
+    mGapEnd = mPreferredGapSize;
+  }
+  mLength = 0;
+  mCursorPosHint = 0;
+  mPrimary.mSelected = 0;
+  mPrimary.mStart = mPrimary.mEnd = 0;
+  mSecondary.mSelected = 0;
+  mSecondary.mStart = mSecondary.mEnd = 0;
+  mHighlight.mSelected = 0;
+  mHighlight.mStart = mHighlight.mEnd = 0;
+  if (undowidget == this)
+    undowidget = 0;
+  if (deletedLength)
+    call_modify_callbacks(0, deletedLength, 0, 0, NULL);
+}
+
+
+/*
+ Release the mappings of the mapped file, and optionally the file.
+ */
+void Fl_Text_Buffer::unmap(int close_file)
+{
+#ifndef WIN32
+  while (mMaps) {
+    Fl_Text_Mapping *m = mMaps;
+    mMaps = m->next;
+    munmap(m->addr, m->size);
+    delete m;
+  }
+  if (close_file && mMapFd >= 0) {
+    close(mMapFd);
+    mMapFd = -1;
+  }
+#endif // !WIN32
+}
+
+
 /*
  Return the previous character position.
  Unicode safe.
@@ -39,6 +39,7 @@
 #include <FL/Fl_Text_Display.H>
 #include <FL/Fl_Window.H>
 #include <FL/Fl_Printer.H>
+#include "Fl_Text_Line_Index.H"
 
 #undef min
 #undef max
@@ -71,6 +72,9 @@ static int max( int i1, int i2 );
 static int min( int i1, int i2 );
 static int countlines( const char *string );
 
+extern void fl_shortcut_register(Fl_Widget*, int);	// in fl_shortcut.cxx
+extern void fl_shortcut_register_label(Fl_Widget*, int);
+
 /* The variables below are used in a timer event to allow smooth
  scrolling of the text area when the pointer has left the area. */
 static int scroll_direction = 0;
@@ -107,6 +111,7 @@ Fl_Text_Display::Fl_Text_Display(int X, int Y, int W, int H, const char* l)
   textcolor(FL_FOREGROUND_COLOR);
   textfont(FL_HELVETICA);
   set_flag(SHORTCUT_LABEL);
+  fl_shortcut_register_label(this, 1);
   
   text_area.x = 0;
   text_area.y = 0;
@@ -134,6 +139,8 @@ Fl_Text_Display::Fl_Text_Display(int X, int Y, int W, int H, const char* l)
   mFirstChar = 0;
   mLastChar = 0;
   mNBufferLines = 0;
+  mLineIndex = 0;
+  mLineIndexKey = 0;
   mTopLineNum = mTopLineNumHint = 1;
   mAbsTopLineNum = 1;
   mNeedAbsTopLineNum = 0;
@@ -165,6 +172,11 @@ Fl_Text_Display::Fl_Text_Display(int X, int Y, int W, int H, const char* l)
 
 
 
+void Fl_Text_Display::shortcut(int s) {
+  shortcut_ = s;
+  fl_shortcut_register(this, s);
+}
+
 /**
  Free a text display and release its associated memory.
  
@@ -181,6 +193,7 @@ Fl_Text_Display::~Fl_Text_Display() {
     mBuffer->remove_predelete_callback(buffer_predelete_cb, this);
   }
   if (mLineStarts) delete[] mLineStarts;
+  delete mLineIndex;
 }
 
 
@@ -193,6 +206,8 @@ void Fl_Text_Display::buffer( Fl_Text_Buffer *buf ) {
   /* If the text display is already displaying a buffer, clear it off
    of the display and remove our callback from it */
   if ( buf == mBuffer) return;
+  delete mLineIndex;
+  mLineIndex = 0;
   if ( mBuffer != 0 ) {
     // we must provide a copy of the buffer that we are deleting!
     char *deletedText = mBuffer->text();
@@ -259,6 +274,7 @@ void Fl_Text_Display::highlight_data(Fl_Text_Buffer *styleBuffer,
   mUnfinishedHighlightCB = unfinishedHighlightCB;
   mHighlightCBArg = cbArg;
   mColumnScale = 0;
+  invalidate_line_index();
   
   mStyleBuffer->canUndo(0);
   damage(FL_DAMAGE_EXPOSE);
@@ -481,7 +497,8 @@ void Fl_Text_Display::draw_text( int left, int top, int width, int height ) {
 /**  
  \brief Marks text from start to end as needing a redraw.
  This function will trigger a damage event and later a redraw of parts of 
- the widget.
+ the widget. Call it after changing the style buffer, so that wrapped
+ lines are measured again with the new styles.
  \param startpos index of first character needing redraw
  \param endpos index after last character needing redraw
  */
@@ -489,6 +506,9 @@ void Fl_Text_Display::redisplay_range(int startpos, int endpos) {
   IS_UTF8_ALIGNED2(buffer(), startpos)
   IS_UTF8_ALIGNED2(buffer(), endpos)
   
+  if (mStyleBuffer)
+    restyle_line_index(startpos, endpos);
+  
   if (damage_range1_start == -1 && damage_range1_end == -1) {
     damage_range1_start = startpos;
     damage_range1_end = endpos;
@@ -1150,15 +1170,26 @@ int Fl_Text_Display::count_lines(int startPos, int endPos,
   IS_UTF8_ALIGNED2(buffer(), endPos)
   
   int retLines, retPos, retLineStart, retLineEnd;
+  int base = 0;
   
 #ifdef DEBUG
   printf("Fl_Text_Display::count_lines(startPos=%d, endPos=%d, startPosIsLineStart=%d\n",
          startPos, endPos, startPosIsLineStart);
 #endif // DEBUG
   
+  /* Counting from the start of the buffer, look up the line containing
+   endPos in the line index and only count the rest */
+  if (startPos == 0 && endPos > 0) {
+    Fl_Text_Line_Index *index = line_index();
+    int line = index->line_of(endPos);
+    base = index->rows_before(line);
+    startPos = index->line_start(line);
+    startPosIsLineStart = true;
+  }
+  
   /* If we're not wrapping use simple (and more efficient) BufCountLines */
   if (!mContinuousWrap)
-    return buffer()->count_lines(startPos, endPos);
+    return base + buffer()->count_lines(startPos, endPos);
   
   wrapped_line_counter(buffer(), startPos, endPos, INT_MAX,
                        startPosIsLineStart, 0, &retPos, &retLines, &retLineStart,
@@ -1169,7 +1200,7 @@ int Fl_Text_Display::count_lines(int startPos, int endPos,
          retPos, retLines, retLineStart, retLineEnd);
 #endif // DEBUG
   
-  return retLines;
+  return base + retLines;
 }
 
 
@@ -1193,6 +1224,15 @@ int Fl_Text_Display::skip_lines(int startPos, int nLines,
 
   int retLines, retPos, retLineStart, retLineEnd;
   
+  /* Skipping from the start of the buffer, look up the line containing
+   the target in the line index and only skip the rest */
+  if (startPos == 0 && nLines > 0) {
+    Fl_Text_Line_Index *index = line_index();
+    int line = index->find_row(nLines, &nLines);
+    startPos = index->line_start(line);
+    startPosIsLineStart = true;
+  }
+  
   /* if we're not wrapping use more efficient BufCountForwardNLines */
   if (!mContinuousWrap)
     return buffer()->skip_lines(startPos, nLines);
@@ -1409,7 +1449,8 @@ void Fl_Text_Display::buffer_predelete_cb(int pos, int nDeleted, void *cbArg) {
  \param nInserted number of bytes we inserted (must be UTF-8 aligned!)
  \param nDeleted number of bytes deleted (must be UTF-8 aligned!)
  \param nRestyled ??
- \param deletedText this is what was removed, must not be NULL if nDeleted is set
+ \param deletedText this is what was removed, or NULL if the buffer dropped
+   all of its text without copying it
  \param cbArg "this" pointer for static callback function
  */
 void Fl_Text_Display::buffer_modified_cb( int pos, int nInserted, int nDeleted,
@@ -1424,9 +1465,32 @@ void Fl_Text_Display::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   IS_UTF8_ALIGNED2(buf, pos)
   IS_UTF8_ALIGNED2(buf, oldFirstChar)
   
+  /* The buffer dropped all of its text without a copy of it (see
+   Fl_Text_Buffer::mapfile()), so start over as with an empty buffer */
+  if ( nDeleted != 0 && !deletedText ) {
+    delete textD->mLineIndex;
+    textD->mLineIndex = 0;
+    textD->mNBufferLines = 0;
+    textD->mFirstChar = textD->mLastChar = 0;
+    textD->mTopLineNum = textD->mAbsTopLineNum = 1;
+    textD->mHorizOffset = 0;
+    textD->mCursorPos = 0;
+    textD->mCursorToHint = NO_HINT;
+    textD->mCursorPreferredXPos = -1;
+    textD->mSuppressResync = textD->mNLinesDeleted = 0;
+    textD->mLineStarts[0] = 0;
+    for (int i = 1; i < textD->mNVisibleLines; i++)
+      textD->mLineStarts[i] = -1;
+    textD->resize(textD->x(), textD->y(), textD->w(), textD->h());
+    textD->damage(FL_DAMAGE_EXPOSE);
+    return;
+  }
+  
   /* buffer modification cancels vertical cursor motion column */
-  if ( nInserted != 0 || nDeleted != 0 )
+  if ( nInserted != 0 || nDeleted != 0 ) {
     textD->mCursorPreferredXPos = -1;
+    textD->update_line_index(pos, nInserted, nDeleted);
+  }
   
   /* Count the number of lines inserted and deleted, and in the case
    of continuous wrap mode, how much has changed */
@@ -1485,8 +1549,12 @@ void Fl_Text_Display::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   /* If the changes caused scrolling, re-paint everything and we're done. */
   if ( scrolled ) {
     textD->damage(FL_DAMAGE_EXPOSE);
-    if ( textD->mStyleBuffer )   /* See comments in extendRangeForStyleMods */
-      textD->mStyleBuffer->primary_selection()->selected(0);
+    if ( textD->mStyleBuffer ) { /* See comments in extendRangeForStyleMods */
+      Fl_Text_Selection *sel = textD->mStyleBuffer->primary_selection();
+      if (sel->selected())
+        textD->restyle_line_index(sel->start(), sel->end());
+      sel->selected(0);
+    }
     return;
   }
   
@@ -1586,7 +1654,9 @@ int Fl_Text_Display::get_absolute_top_line_number() const {
  */
 void Fl_Text_Display::absolute_top_line_number(int oldFirstChar) {
   if (maintaining_absolute_top_line_number()) {
-    if (mFirstChar < oldFirstChar)
+    if (mLineIndex)
+      mAbsTopLineNum = mLineIndex->line_of(mFirstChar) + 1;
+    else if (mFirstChar < oldFirstChar)
       mAbsTopLineNum -= buffer()->count_lines(mFirstChar, oldFirstChar);
     else
       mAbsTopLineNum += buffer()->count_lines(oldFirstChar, mFirstChar);
@@ -2284,27 +2354,25 @@ void Fl_Text_Display::offset_line_starts( int newTopLineNum ) {
   int nVisLines = mNVisibleLines;
   int *lineStarts = mLineStarts;
   int i, lastLineNum;
-  Fl_Text_Buffer *buf = mBuffer;
   
   /* If there was no offset, nothing needs to be changed */
   if ( lineDelta == 0 )
     return;
   
-  /* Find the new value for mFirstChar by counting lines from the nearest
-   known line start (start or end of buffer, or the closest value in the
-   lineStarts array) */
+  /* Find the new value for mFirstChar by counting lines from the closest
+   value in the lineStarts array, or, for larger jumps, by looking it up
+   in the line index */
   lastLineNum = oldTopLineNum + nVisLines - 1;
-  if ( newTopLineNum < oldTopLineNum && newTopLineNum < -lineDelta ) {
-    mFirstChar = skip_lines( 0, newTopLineNum - 1, true );
-  } else if ( newTopLineNum < oldTopLineNum ) {
+  if ( newTopLineNum < oldTopLineNum && -lineDelta < nVisLines ) {
     mFirstChar = rewind_lines( mFirstChar, -lineDelta );
-  } else if ( newTopLineNum < lastLineNum ) {
+  } else if ( newTopLineNum > oldTopLineNum && newTopLineNum < lastLineNum ) {
     mFirstChar = lineStarts[ newTopLineNum - oldTopLineNum ];
-  } else if ( newTopLineNum - lastLineNum < mNBufferLines - newTopLineNum ) {
+  } else if ( newTopLineNum > oldTopLineNum && newTopLineNum - lastLineNum < nVisLines &&
+              lineStarts[ nVisLines - 1 ] != -1 ) {
     mFirstChar = skip_lines( lineStarts[ nVisLines - 1 ],
                             newTopLineNum - lastLineNum, true );
   } else {
-    mFirstChar = rewind_lines( buf->length(), mNBufferLines - newTopLineNum + 1 );
+    mFirstChar = skip_lines( 0, newTopLineNum - 1, true );
   }
   
   /* Fill in the line starts array */
@@ -3291,6 +3359,159 @@ int Fl_Text_Display::wrap_uses_character(int lineEndPos) const {
 
 
 
+/**
+ \brief Returns the width the line index was measured with.
+
+ This is the wrap margin in continuous wrap mode, and INT_MIN otherwise.
+ The line index must be rebuilt whenever it changes.
+ */
+int Fl_Text_Display::line_index_key() const {
+  if (!mContinuousWrap)
+    return INT_MIN;
+  return mWrapMarginPix ? mWrapMarginPix : text_area.w;
+}
+
+
+
+/**
+ \brief Drop the line index if the display lines depend on the font.
+
+ In continuous wrap mode the number of display lines of every buffer line
+ depends on the text font, size and style table, so the index is built
+ again when one of them changes.
+ */
+void Fl_Text_Display::invalidate_line_index() {
+  if (mContinuousWrap) {
+    delete mLineIndex;
+    mLineIndex = 0;
+  }
+}
+
+
+
+/**
+ \brief Measure the lines of a range again after their style changed.
+
+ In continuous wrap mode a new style can change where the lines wrap.
+ Style changes are reported through the style buffer selection during a
+ buffer modification, and through redisplay_range() otherwise.
+
+ \param start index of the first restyled character
+ \param end index after the last restyled character
+ */
+void Fl_Text_Display::restyle_line_index(int start, int end) {
+  if (!mLineIndex || !mContinuousWrap || !buffer())
+    return;
+  int len = buffer()->length();
+  if (start < 0) start = 0;
+  if (end > len) end = len;
+  if (start > end)
+    return;
+  update_line_index(start, end - start, end - start);
+}
+
+
+
+/**
+ \brief Count the displayed lines of one buffer line.
+
+ \param start index of the first character of the line
+ \param end index of the newline ending the line, or the buffer length
+ \return 1, plus the number of times the line wraps in continuous wrap mode
+ */
+int Fl_Text_Display::line_rows(int start, int end) const {
+  int retPos, retLines, retLineStart, retLineEnd;
+
+  if (!mContinuousWrap || start == end)
+    return 1;
+  wrapped_line_counter(buffer(), start, end, INT_MAX, true, 0,
+                       &retPos, &retLines, &retLineStart, &retLineEnd, false);
+  return retLines + 1;
+}
+
+
+
+/**
+ \brief Returns the line index, building it if needed.
+
+ The line index holds the length and the number of displayed lines of
+ every line in the buffer, so that count_lines() and skip_lines() from
+ the start of the buffer, and with them scrolling to any line, take
+ O(log n) steps instead of walking the text. It is built on first use,
+ kept up to date by the buffer modification callback, and built again
+ when the wrap margin, the text font or size, or the styles change.
+ */
+Fl_Text_Line_Index *Fl_Text_Display::line_index() const {
+  int key = line_index_key();
+  if (mLineIndex && mLineIndexKey != key) {
+    delete mLineIndex;
+    mLineIndex = 0;
+  }
+  if (!mLineIndex) {
+    Fl_Text_Buffer *buf = buffer();
+    int len = buf->length();
+    mLineIndex = new Fl_Text_Line_Index;
+    mLineIndexKey = key;
+    for (int pos = 0; ; pos++) {
+      int end = buf->line_end(pos);
+      mLineIndex->append(end - pos + (end < len), line_rows(pos, end));
+      if (end >= len)
+        break;
+      pos = end;
+    }
+    mLineIndex->finish();
+  }
+  return mLineIndex;
+}
+
+
+
+/**
+ \brief Update the line index after a buffer modification.
+
+ The buffer lines touched by the modification are measured again and
+ replace their old entries. In continuous wrap mode, measuring a lot of
+ text costs more than building the index again when it is next needed,
+ so the index is dropped instead.
+
+ \param pos index of the modification
+ \param nInserted number of bytes inserted
+ \param nDeleted number of bytes deleted
+ */
+void Fl_Text_Display::update_line_index(int pos, int nInserted, int nDeleted) {
+  Fl_Text_Line_Index *index = mLineIndex;
+  Fl_Text_Buffer *buf = buffer();
+
+  if (!index)
+    return;
+
+  int first = index->line_of(pos);
+  int last = index->line_of(pos + nDeleted);
+  int start = index->line_start(first);
+  int end = buf->line_end(pos + nInserted);
+  if (mLineIndexKey != line_index_key() ||
+      (mContinuousWrap && end - start > 65536)) {
+    delete mLineIndex;
+    mLineIndex = 0;
+    return;
+  }
+
+  int len = buf->length();
+  int n = buf->count_lines(start, end) + 1;
+  int *lengths = new int[2 * n];
+  int *rows = lengths + n;
+  for (int i = 0, p = start; i < n; i++) {
+    int e = buf->line_end(p);
+    lengths[i] = e - p + (e < len);
+    rows[i] = line_rows(p, e);
+    p = e + 1;
+  }
+  index->replace(first, last - first + 1, lengths, rows, n);
+  delete[] lengths;
+}
+
+
+
 /**
  \brief I don't know what this does!
  
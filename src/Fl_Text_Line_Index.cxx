@@ -0,0 +1,348 @@
+//
+// "$Id$"
+//
+// Line index for Fl_Text_Display.
+//
+// Copyright 2001-2010 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <stdlib.h>
+#include "flstring.h"
+#include "Fl_Text_Line_Index.H"
+
+struct Fl_Text_Line_Block {
+  int n;                        // lines in this block
+  int bytes, rows;              // totals of this block
+  int len[FL_TEXT_LINE_BLOCK];
+  int row[FL_TEXT_LINE_BLOCK];
+};
+
+// blocks filled when lines are inserted are left with room to grow
+static const int BLOCK_FILL = FL_TEXT_LINE_BLOCK * 3 / 4;
+
+Fl_Text_Line_Index::Fl_Text_Line_Index() {
+  blocks = 0;
+  nblocks = ablocks = 0;
+  fbytes = flines = frows = 0;
+  top = 0;
+  total_bytes = total_lines = total_rows = 0;
+}
+
+Fl_Text_Line_Index::~Fl_Text_Line_Index() {
+  for (int i = 0; i < nblocks; i++)
+    free(blocks[i]);
+  free(blocks);
+  free(fbytes);
+  free(flines);
+  free(frows);
+}
+
+Fl_Text_Line_Block *Fl_Text_Line_Index::add_block(int at) {
+  if (nblocks == ablocks) {
+    ablocks = ablocks ? 2 * ablocks : 16;
+    blocks = (Fl_Text_Line_Block **)realloc(blocks, ablocks * sizeof(Fl_Text_Line_Block *));
+  }
+  memmove(blocks + at + 1, blocks + at, (nblocks - at) * sizeof(Fl_Text_Line_Block *));
+  nblocks++;
+  Fl_Text_Line_Block *k = (Fl_Text_Line_Block *)calloc(1, sizeof(Fl_Text_Line_Block));
+  blocks[at] = k;
+  return k;
+}
+
+void Fl_Text_Line_Index::remove_block(int at) {
+  free(blocks[at]);
+  nblocks--;
+  memmove(blocks + at, blocks + at + 1, (nblocks - at) * sizeof(Fl_Text_Line_Block *));
+}
+
+/*
+ Builds the Fenwick trees from the block totals in linear time.
+ */
+void Fl_Text_Line_Index::rebuild() {
+  fbytes = (int *)realloc(fbytes, (nblocks + 1) * sizeof(int));
+  flines = (int *)realloc(flines, (nblocks + 1) * sizeof(int));
+  frows = (int *)realloc(frows, (nblocks + 1) * sizeof(int));
+  fbytes[0] = flines[0] = frows[0] = 0;
+  for (int i = 1; i <= nblocks; i++) {
+    fbytes[i] = blocks[i - 1]->bytes;
+    flines[i] = blocks[i - 1]->n;
+    frows[i] = blocks[i - 1]->rows;
+  }
+  for (int i = 1; i <= nblocks; i++) {
+    int j = i + (i & -i);
+    if (j <= nblocks) {
+      fbytes[j] += fbytes[i];
+      flines[j] += flines[i];
+      frows[j] += frows[i];
+    }
+  }
+  for (top = 1; top * 2 <= nblocks; top *= 2) ;
+  if (!nblocks) top = 0;
+}
+
+void Fl_Text_Line_Index::fenwick_add(int b, int dbytes, int dlines, int drows) {
+  for (int i = b + 1; i <= nblocks; i += i & -i) {
+    fbytes[i] += dbytes;
+    flines[i] += dlines;
+    frows[i] += drows;
+  }
+}
+
+// sum of the first b blocks
+int Fl_Text_Line_Index::fenwick_sum(const int *f, int b) const {
+  int sum = 0;
+  for (int i = b; i > 0; i -= i & -i)
+    sum += f[i];
+  return sum;
+}
+
+// first block that brings the running sum above target, or nblocks
+int Fl_Text_Line_Index::fenwick_find(const int *f, int target, int *before) const {
+  int idx = 0, sum = 0;
+  for (int step = top; step; step >>= 1) {
+    if (idx + step <= nblocks && sum + f[idx + step] <= target) {
+      idx += step;
+      sum += f[idx];
+    }
+  }
+  *before = sum;
+  return idx;
+}
+
+// block holding a line and the line's offset in it, or -1
+int Fl_Text_Line_Index::find_line(int line, int *offset) const {
+  if (line < 0 || line >= total_lines)
+    return -1;
+  int before;
+  int b = fenwick_find(flines, line, &before);
+  *offset = line - before;
+  return b;
+}
+
+/*
+ Adds a line at the end while building the index. finish() must be
+ called before the index is used.
+ */
+void Fl_Text_Line_Index::append(int len, int rows) {
+  Fl_Text_Line_Block *k = nblocks ? blocks[nblocks - 1] : 0;
+  if (!k || k->n == FL_TEXT_LINE_BLOCK)
+    k = add_block(nblocks);
+  k->len[k->n] = len;
+  k->row[k->n] = rows;
+  k->n++;
+  k->bytes += len;
+  k->rows += rows;
+  total_bytes += len;
+  total_lines++;
+  total_rows += rows;
+}
+
+void Fl_Text_Line_Index::finish() {
+  rebuild();
+}
+
+/*
+ Replaces count lines starting at line first with n new lines.
+ */
+void Fl_Text_Line_Index::replace(int first, int count, const int *len, const int *rows, int n) {
+  int restructured = 0;
+  int i, o, b = find_line(first, &o);
+
+  // remove the old lines
+  while (count > 0 && b >= 0 && b < nblocks) {
+    Fl_Text_Line_Block *k = blocks[b];
+    int m = k->n - o;
+    if (m > count) m = count;
+    int db = 0, dr = 0;
+    for (i = o; i < o + m; i++) {
+      db += k->len[i];
+      dr += k->row[i];
+    }
+    memmove(k->len + o, k->len + o + m, (k->n - o - m) * sizeof(int));
+    memmove(k->row + o, k->row + o + m, (k->n - o - m) * sizeof(int));
+    k->n -= m;
+    k->bytes -= db;
+    k->rows -= dr;
+    total_bytes -= db;
+    total_lines -= m;
+    total_rows -= dr;
+    count -= m;
+    if (!k->n && nblocks > 1) {
+      remove_block(b);
+      restructured = 1;
+    } else {
+      if (!restructured) fenwick_add(b, -db, -m, -dr);
+      b++;
+    }
+    o = 0;
+  }
+  if (restructured) {
+    rebuild();
+    restructured = 0;
+  }
+  if (n <= 0)
+    return;
+
+  // find where the new lines go
+  b = find_line(first, &o);
+  if (b < 0) {
+    if (!nblocks) {
+      add_block(0);
+      rebuild();
+    }
+    b = nblocks - 1;
+    o = blocks[b]->n;
+  }
+  Fl_Text_Line_Block *k = blocks[b];
+
+  int db = 0, dr = 0;
+  for (i = 0; i < n; i++) {
+    db += len[i];
+    dr += rows[i];
+  }
+  total_bytes += db;
+  total_lines += n;
+  total_rows += dr;
+
+  if (k->n + n <= FL_TEXT_LINE_BLOCK) {
+    memmove(k->len + o + n, k->len + o, (k->n - o) * sizeof(int));
+    memmove(k->row + o + n, k->row + o, (k->n - o) * sizeof(int));
+    memcpy(k->len + o, len, n * sizeof(int));
+    memcpy(k->row + o, rows, n * sizeof(int));
+    k->n += n;
+    k->bytes += db;
+    k->rows += dr;
+    fenwick_add(b, db, n, dr);
+    return;
+  }
+
+  // split the block: take its tail out, then refill it and new blocks
+  // with the new lines followed by the tail
+  int tail = k->n - o;
+  int *tlen = (int *)malloc(2 * tail * sizeof(int) + 1);
+  int *trow = tlen + tail;
+  memcpy(tlen, k->len + o, tail * sizeof(int));
+  memcpy(trow, k->row + o, tail * sizeof(int));
+  for (i = 0; i < tail; i++) {
+    k->bytes -= tlen[i];
+    k->rows -= trow[i];
+  }
+  k->n = o;
+  int cap = o > BLOCK_FILL ? o : BLOCK_FILL;
+  for (i = 0; i < n + tail; i++) {
+    if (k->n >= cap) {
+      k = add_block(++b);
+      cap = BLOCK_FILL;
+    }
+    int l = i < n ? len[i] : tlen[i - n];
+    int r = i < n ? rows[i] : trow[i - n];
+    k->len[k->n] = l;
+    k->row[k->n] = r;
+    k->n++;
+    k->bytes += l;
+    k->rows += r;
+  }
+  free(tlen);
+  rebuild();
+}
+
+/*
+ Returns the position of the first character of a line, counting from 0.
+ */
+int Fl_Text_Line_Index::line_start(int line) const {
+  int o, b = find_line(line, &o);
+  if (b < 0)
+    return line <= 0 ? 0 : total_bytes;
+  int pos = fenwick_sum(fbytes, b);
+  const Fl_Text_Line_Block *k = blocks[b];
+  for (int i = 0; i < o; i++)
+    pos += k->len[i];
+  return pos;
+}
+
+/*
+ Returns the line, counting from 0, that holds position pos.
+ */
+int Fl_Text_Line_Index::line_of(int pos) const {
+  if (pos >= total_bytes)
+    return total_lines ? total_lines - 1 : 0;
+  if (pos < 0)
+    return 0;
+  int before;
+  int b = fenwick_find(fbytes, pos, &before);
+  int line = fenwick_sum(flines, b);
+  const Fl_Text_Line_Block *k = blocks[b];
+  for (int i = 0; i < k->n; i++) {
+    before += k->len[i];
+    if (before > pos)
+      return line + i;
+  }
+  return line + k->n - 1;
+}
+
+/*
+ Returns the number of rows of all lines before line.
+ */
+int Fl_Text_Line_Index::rows_before(int line) const {
+  int o, b = find_line(line, &o);
+  if (b < 0)
+    return line <= 0 ? 0 : total_rows;
+  int rows = fenwick_sum(frows, b);
+  const Fl_Text_Line_Block *k = blocks[b];
+  for (int i = 0; i < o; i++)
+    rows += k->row[i];
+  return rows;
+}
+
+/*
+ Returns the line in which row number row (counting from 0) is found, and
+ in sub the number of rows of that line that come before it. Rows beyond
+ the end are reported as part of the last line.
+ */
+int Fl_Text_Line_Index::find_row(int row, int *sub) const {
+  if (!total_lines) {
+    *sub = 0;
+    return 0;
+  }
+  if (row >= total_rows) {
+    *sub = row - rows_before(total_lines - 1);
+    return total_lines - 1;
+  }
+  if (row < 0) row = 0;
+  int before;
+  int b = fenwick_find(frows, row, &before);
+  int line = fenwick_sum(flines, b);
+  const Fl_Text_Line_Block *k = blocks[b];
+  for (int i = 0; i < k->n; i++) {
+    if (before + k->row[i] > row) {
+      *sub = row - before;
+      return line + i;
+    }
+    before += k->row[i];
+  }
+  *sub = row - before;
+  return line + k->n - 1;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,393 @@
+//
+// "$Id$"
+//
+// Piece table storage for Fl_Text_Buffer.
+//
+// Copyright 2001-2010 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <stdlib.h>
+#include "flstring.h"
+#include "Fl_Text_Rope.H"
+
+struct Fl_Text_Rope_Node {
+  const char *text;             // this piece
+  int len, nl;
+  int size, lines;              // bytes and newlines in the whole subtree
+  unsigned prio;
+  Fl_Text_Rope_Node *left, *right;
+};
+
+struct Fl_Text_Rope_Block {
+  Fl_Text_Rope_Block *next;
+  int size, used;
+  // followed by size bytes of text
+};
+
+static const int BLOCK_SIZE = 256 * 1024;
+
+static inline int size_of(Fl_Text_Rope_Node *t) { return t ? t->size : 0; }
+static inline int lines_of(Fl_Text_Rope_Node *t) { return t ? t->lines : 0; }
+
+static inline void update(Fl_Text_Rope_Node *t) {
+  t->size = t->len + size_of(t->left) + size_of(t->right);
+  t->lines = t->nl + lines_of(t->left) + lines_of(t->right);
+}
+
+static int count_newlines(const char *p, int n) {
+  int count = 0;
+  const char *e = p + n;
+  while ((p = (const char *)memchr(p, '\n', e - p))) {
+    count++;
+    p++;
+  }
+  return count;
+}
+
+static Fl_Text_Rope_Node *merge(Fl_Text_Rope_Node *a, Fl_Text_Rope_Node *b) {
+  if (!a) return b;
+  if (!b) return a;
+  if (a->prio > b->prio) {
+    a->right = merge(a->right, b);
+    update(a);
+    return a;
+  }
+  b->left = merge(a, b->left);
+  update(b);
+  return b;
+}
+
+static void free_tree(Fl_Text_Rope_Node *t) {
+  if (!t) return;
+  free_tree(t->left);
+  free_tree(t->right);
+  delete t;
+}
+
+/*
+ Grows the last piece of t by len bytes if they directly follow it in
+ storage, which is the case when the user types at the same spot.
+ */
+static int extend(Fl_Text_Rope_Node *t, const char *text, int len) {
+  if (!t)
+    return 0;
+  if (t->right) {
+    if (!extend(t->right, text, len))
+      return 0;
+  } else {
+    if (t->text + t->len != text || t->len + len > FL_TEXT_PIECE_MAX)
+      return 0;
+    t->len += len;
+    t->nl += count_newlines(text, len);
+  }
+  update(t);
+  return 1;
+}
+
+Fl_Text_Rope::Fl_Text_Rope() {
+  root = 0;
+  blocks = 0;
+  stored = 0;
+  seed = 2463534242u;
+  last = 0;
+  last_start = 0;
+}
+
+Fl_Text_Rope::~Fl_Text_Rope() {
+  clear();
+}
+
+int Fl_Text_Rope::length() const {
+  return size_of(root);
+}
+
+int Fl_Text_Rope::lines() const {
+  return lines_of(root);
+}
+
+/*
+ Removes all text and releases all storage.
+ */
+void Fl_Text_Rope::clear() {
+  free_tree(root);
+  root = 0;
+  while (blocks) {
+    Fl_Text_Rope_Block *b = blocks;
+    blocks = b->next;
+    free(b);
+  }
+  stored = 0;
+  last = 0;
+}
+
+/*
+ Copies text into the append-only storage and returns its address there.
+ */
+const char *Fl_Text_Rope::store(const char *text, int len) {
+  Fl_Text_Rope_Block *b = blocks;
+  if (!b || b->size - b->used < len) {
+    int size = len > BLOCK_SIZE ? len : BLOCK_SIZE;
+    b = (Fl_Text_Rope_Block *)malloc(sizeof(Fl_Text_Rope_Block) + size);
+    b->size = size;
+    b->used = 0;
+    b->next = blocks;
+    blocks = b;
+  }
+  char *p = (char *)(b + 1) + b->used;
+  memcpy(p, text, len);
+  b->used += len;
+  stored += len;
+  return p;
+}
+
+Fl_Text_Rope_Node *Fl_Text_Rope::new_node(const char *text, int len, int nl) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  Fl_Text_Rope_Node *t = new Fl_Text_Rope_Node;
+  t->text = text;
+  t->len = len;
+  t->nl = nl;
+  t->prio = seed;
+  t->left = t->right = 0;
+  update(t);
+  return t;
+}
+
+/*
+ Splits t into the first pos bytes and the rest, cutting a piece in two
+ if pos falls inside it.
+ */
+void Fl_Text_Rope::split(Fl_Text_Rope_Node *t, int pos,
+                         Fl_Text_Rope_Node *&l, Fl_Text_Rope_Node *&r) {
+  if (!t) {
+    l = r = 0;
+    return;
+  }
+  int ls = size_of(t->left);
+  if (pos <= ls) {
+    split(t->left, pos, l, t->left);
+    update(t);
+    r = t;
+  } else if (pos >= ls + t->len) {
+    split(t->right, pos - ls - t->len, t->right, r);
+    update(t);
+    l = t;
+  } else {
+    int off = pos - ls;
+    // count the newlines in the shorter half
+    int nl = (off <= t->len / 2) ? count_newlines(t->text, off)
+                                 : t->nl - count_newlines(t->text + off, t->len - off);
+    Fl_Text_Rope_Node *n = new_node(t->text + off, t->len - off, t->nl - nl);
+    n->prio = t->prio;
+    n->right = t->right;
+    update(n);
+    t->len = off;
+    t->nl = nl;
+    t->right = 0;
+    update(t);
+    l = t;
+    r = n;
+  }
+}
+
+/*
+ Inserts len bytes of text at pos.
+ pos must be at a character boundary and text must be complete UTF-8.
+ */
+void Fl_Text_Rope::insert(int pos, const char *text, int len) {
+  if (len <= 0)
+    return;
+  add_pieces(pos, store(text, len), len, 1);
+}
+
+/*
+ Inserts len bytes at pos without copying them. The text must stay
+ valid and unchanged for as long as the rope is not cleared.
+ */
+void Fl_Text_Rope::reference(int pos, const char *text, int len) {
+  if (len <= 0)
+    return;
+  add_pieces(pos, text, len, 0);
+}
+
+/*
+ Inserts pieces for text that is already in its final place in memory,
+ growing the piece before pos instead if allowed and possible.
+ */
+void Fl_Text_Rope::add_pieces(int pos, const char *p, int len, int can_extend) {
+  last = 0;
+
+  Fl_Text_Rope_Node *l, *r;
+  split(root, pos, l, r);
+  if (!can_extend || !extend(l, p, len)) {
+    while (len > 0) {
+      int n = len;
+      if (n > FL_TEXT_PIECE_MAX) {
+        // don't cut a character in two
+        n = FL_TEXT_PIECE_MAX;
+        while (n > FL_TEXT_PIECE_MAX - 4 && (p[n] & 0xc0) == 0x80)
+          n--;
+      }
+      l = merge(l, new_node(p, n, count_newlines(p, n)));
+      p += n;
+      len -= n;
+    }
+  }
+  root = merge(l, r);
+}
+
+/*
+ Removes the bytes from start up to end.
+ */
+void Fl_Text_Rope::remove(int start, int end) {
+  if (end <= start)
+    return;
+  last = 0;
+
+  Fl_Text_Rope_Node *l, *m, *r;
+  split(root, start, l, m);
+  split(m, end - start, m, r);
+  free_tree(m);
+  root = merge(l, r);
+
+  // removed text stays in storage; copy the rest out once most of the
+  // storage is garbage
+  int n = size_of(root);
+  if (stored > 4 * (long)n + 4 * BLOCK_SIZE) {
+    char *t = (char *)malloc(n);
+    copy_out(0, n, t);
+    clear();
+    insert(0, t, n);
+    free(t);
+  }
+}
+
+/*
+ Copies the bytes from start up to end to dest.
+ */
+void Fl_Text_Rope::copy_out(int start, int end, char *dest) const {
+  while (start < end) {
+    int n;
+    const char *p = span(start, &n);
+    if (!n)
+      break;
+    if (n > end - start)
+      n = end - start;
+    memcpy(dest, p, n);
+    dest += n;
+    start += n;
+  }
+}
+
+/*
+ Returns the address of the byte at pos and, in len, the number of bytes
+ that can be read from there without crossing into another piece.
+ */
+const char *Fl_Text_Rope::span(int pos, int *len) const {
+  Fl_Text_Rope_Node *t = last;
+  int start = last_start;
+  if (!t || pos < start || pos >= start + t->len) {
+    t = root;
+    start = 0;
+    while (t) {
+      int ls = size_of(t->left);
+      if (pos < start + ls) {
+        t = t->left;
+      } else if (pos < start + ls + t->len) {
+        start += ls;
+        break;
+      } else {
+        start += ls + t->len;
+        t = t->right;
+      }
+    }
+    if (!t || pos < 0) {
+      if (len) *len = 0;
+      return "";
+    }
+    last = t;
+    last_start = start;
+  }
+  if (len) *len = t->len - (pos - start);
+  return t->text + (pos - start);
+}
+
+/*
+ Returns the number of newlines in the bytes before pos.
+ */
+int Fl_Text_Rope::newlines_before(int pos) const {
+  int count = 0;
+  Fl_Text_Rope_Node *t = root;
+  while (t) {
+    int ls = size_of(t->left);
+    if (pos < ls) {
+      t = t->left;
+    } else if (pos < ls + t->len) {
+      int off = pos - ls;
+      count += lines_of(t->left);
+      if (off <= t->len / 2)
+        return count + count_newlines(t->text, off);
+      return count + t->nl - count_newlines(t->text + off, t->len - off);
+    } else {
+      count += lines_of(t->left) + t->nl;
+      pos -= ls + t->len;
+      t = t->right;
+    }
+  }
+  return count;
+}
+
+/*
+ Returns the position following newline number line (counting from 1),
+ or the length of the text if there are fewer newlines.
+ */
+int Fl_Text_Rope::line_position(int line) const {
+  if (line <= 0)
+    return 0;
+  int pos = 0;
+  Fl_Text_Rope_Node *t = root;
+  while (t) {
+    int ll = lines_of(t->left);
+    if (line <= ll) {
+      t = t->left;
+    } else if (line <= ll + t->nl) {
+      pos += size_of(t->left);
+      const char *p = t->text;
+      for (line -= ll; ; line--) {
+        p = (const char *)memchr(p, '\n', t->text + t->len - p) + 1;
+        if (line == 1)
+          break;
+      }
+      return pos + (p - t->text);
+    } else {
+      line -= ll + t->nl;
+      pos += size_of(t->left) + t->len;
+      t = t->right;
+    }
+  }
+  return size_of(root);
+}
+
+//
+// End of "$Id$".
+//
@@ -21,6 +21,10 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Window.H>
 #include <FL/Fl_Preferences.H>
+#include <FL/Fl_Device.H>
+#include <FL/Fl_Cairo.H>
+#include <stdlib.h>
+#include <math.h>
 
 Fl_Theme *Fl_Theme::first;
 Fl_Theme *Fl_Theme::_current;
@@ -152,6 +156,8 @@ Fl_Theme::set ( const char *name )
             /* reset boxtypes */
             Fl::reload_scheme();
 
+            flush_box_cache();
+
             t->_init_func();
             Fl_Theme::_current = t;
             
@@ -166,6 +172,8 @@ Fl_Theme::set ( const char *name )
 void
 Fl_Theme::refresh ( void )
 {
+    Fl_Group::invalidate_caches();
+
     for ( Fl_Window *w = Fl::first_window(); w; w = Fl::next_window( w ) )
         w->redraw();
 }
@@ -205,6 +213,8 @@ Fl_Color_Scheme::save ( void )
 void 
 Fl_Color_Scheme::refresh ( void )
 {
+    Fl_Group::invalidate_caches();
+
     for ( Fl_Window *w = Fl::first_window(); w; w = Fl::next_window( w ) )
         w->redraw();
 }
@@ -229,6 +239,8 @@ Fl_Color_Scheme::set ( const char *name )
 
             Fl_Color_Scheme::_current = t;
 
+            Fl_Theme::flush_box_cache();
+
             refresh();
 
             return 1;
@@ -239,5 +251,198 @@ Fl_Color_Scheme::set ( const char *name )
 
 
 
+/* Box cache */
+
+/* Theme boxes are mostly drawn at a handful of sizes and colors, but
+ * stroking their anti-aliased outlines and gradients with Cairo is
+ * expensive. The first time a box is drawn it is rendered into a
+ * surface similar to the window's, and later draws of the same box
+ * just composite that surface. Boxes larger than BOX_CACHE_MAX_AREA
+ * are drawn directly, and the least recently used surfaces are
+ * dropped when the cache grows beyond BOX_CACHE_MAX_PIXELS. */
+
+#define BOX_CACHE_BUCKETS 256
+#define BOX_CACHE_MAX_AREA ( 256 * 256 )
+#define BOX_CACHE_MAX_PIXELS ( 2048 * 1024 )
+
+struct box_cache_entry
+{
+    box_cache_entry *next;                                      /* hash chain */
+    box_cache_entry *prev_used, *next_used;                     /* LRU list */
+
+    Fl_Box_Draw_F *f;
+    int w, h;
+    Fl_Color c;
+    unsigned rgb, bg, bg2, fg;
+    char active;
+
+    unsigned hash;
+    cairo_surface_t *surface;
+};
+
+static box_cache_entry *box_cache[ BOX_CACHE_BUCKETS ];
+static box_cache_entry *box_cache_mru, *box_cache_lru;
+static long box_cache_pixels;
+
+static void
+box_cache_unlink_used ( box_cache_entry *e )
+{
+    if ( e->prev_used )
+        e->prev_used->next_used = e->next_used;
+    else
+        box_cache_mru = e->next_used;
+
+    if ( e->next_used )
+        e->next_used->prev_used = e->prev_used;
+    else
+        box_cache_lru = e->prev_used;
+}
+
+static void
+box_cache_link_used ( box_cache_entry *e )
+{
+    e->prev_used = 0;
+    e->next_used = box_cache_mru;
+
+    if ( box_cache_mru )
+        box_cache_mru->prev_used = e;
+    else
+        box_cache_lru = e;
+
+    box_cache_mru = e;
+}
+
+static void
+box_cache_remove ( box_cache_entry *e )
+{
+    box_cache_entry **p = &box_cache[ e->hash % BOX_CACHE_BUCKETS ];
+
+    while ( *p != e )
+        p = &(*p)->next;
+
+    *p = e->next;
+
+    box_cache_unlink_used( e );
+
+    box_cache_pixels -= (long)e->w * e->h;
+
+    cairo_surface_destroy( e->surface );
+    delete e;
+}
+
+void
+Fl_Theme::flush_box_cache ( void )
+{
+    while ( box_cache_lru )
+        box_cache_remove( box_cache_lru );
+}
 
+/** Draws the box function /f/ like /f/( X, Y, W, H, c ) would, using a
+ * cached rendering of it when possible. */
+void
+Fl_Theme::draw_cached_box ( Fl_Box_Draw_F *f, int X, int Y, int W, int H, Fl_Color c )
+{
+    cairo_t *cr = Fl::cairo_cc();
+
+    if ( ! cr ||
+         W <= 0 || H <= 0 ||
+         (long)W * H > BOX_CACHE_MAX_AREA ||
+         Fl_Surface_Device::surface() != Fl_Display_Device::display_device() )
+    {
+        f( X, Y, W, H, c );
+        return;
+    }
+
+    /* a cached rendering is only pixel exact under integer translations */
+    cairo_matrix_t m;
+    cairo_get_matrix( cr, &m );
+
+    if ( m.xx != 1.0 || m.yy != 1.0 || m.xy != 0.0 || m.yx != 0.0 ||
+         m.x0 != floor( m.x0 ) || m.y0 != floor( m.y0 ) )
+    {
+        f( X, Y, W, H, c );
+        return;
+    }
+
+    /* the boxes derive their colors from these as well */
+    unsigned rgb = ( c & 0xFFFFFF00 ) ? (unsigned)c : Fl::get_color( c );
+    unsigned bg = Fl::get_color( FL_BACKGROUND_COLOR );
+    unsigned bg2 = Fl::get_color( FL_BACKGROUND2_COLOR );
+    unsigned fg = Fl::get_color( FL_FOREGROUND_COLOR );
+    char active = Fl::draw_box_active() ? 1 : 0;
+
+    unsigned hash = 2166136261U;
+
+    hash = ( hash ^ (unsigned)(unsigned long)f ) * 16777619U;
+    hash = ( hash ^ (unsigned)W ) * 16777619U;
+    hash = ( hash ^ (unsigned)H ) * 16777619U;
+    hash = ( hash ^ (unsigned)c ) * 16777619U;
+    hash = ( hash ^ rgb ) * 16777619U;
+    hash = ( hash ^ (unsigned)active ) * 16777619U;
+
+    box_cache_entry *e;
+
+    for ( e = box_cache[ hash % BOX_CACHE_BUCKETS ]; e; e = e->next )
+        if ( e->hash == hash && e->f == f && e->w == W && e->h == H &&
+             e->c == c && e->rgb == rgb && e->active == active &&
+             e->bg == bg && e->bg2 == bg2 && e->fg == fg )
+            break;
+
+    if ( e )
+    {
+        box_cache_unlink_used( e );
+        box_cache_link_used( e );
+    }
+    else
+    {
+        cairo_surface_t *s = cairo_surface_create_similar( cairo_get_target( cr ),
+                                                           CAIRO_CONTENT_COLOR_ALPHA,
+                                                           W, H );
+
+        if ( cairo_surface_status( s ) != CAIRO_STATUS_SUCCESS )
+        {
+            cairo_surface_destroy( s );
+            f( X, Y, W, H, c );
+            return;
+        }
 
+        /* render the box at the origin of the new surface */
+        cairo_t *old_cc = fl_cairo_context;
+        fl_cairo_context = cairo_create( s );
+
+        f( 0, 0, W, H, c );
+
+        cairo_destroy( fl_cairo_context );
+        fl_cairo_context = old_cc;
+
+        e = new box_cache_entry;
+
+        e->f = f;
+        e->w = W;
+        e->h = H;
+        e->c = c;
+        e->rgb = rgb;
+        e->bg = bg;
+        e->bg2 = bg2;
+        e->fg = fg;
+        e->active = active;
+        e->hash = hash;
+        e->surface = s;
+
+        e->next = box_cache[ hash % BOX_CACHE_BUCKETS ];
+        box_cache[ hash % BOX_CACHE_BUCKETS ] = e;
+        box_cache_link_used( e );
+
+        box_cache_pixels += (long)W * H;
+
+        while ( box_cache_pixels > BOX_CACHE_MAX_PIXELS && box_cache_lru != e )
+            box_cache_remove( box_cache_lru );
+    }
+
+    /* keep the caller's source intact */
+    cairo_save( cr );
+    cairo_set_source_surface( cr, e->surface, X, Y );
+    cairo_rectangle( cr, X, Y, W, H );
+    cairo_fill( cr );
+    cairo_restore( cr );
+}
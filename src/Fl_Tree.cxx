@@ -41,15 +41,22 @@ static void scroll_cb(Fl_Widget*,void *data) {
 //    Handles escape characters.
 //    Path="/aa/bb"
 //    Return: arr[0]="aa", arr[1]="bb", arr[2]=0
-//    Caller must call free_path(arr).
+//    The strings are kept in 'buf', and both 'buf' and 'arr' are
+//    reused from call to call, growing them as needed.
+//    Caller must free() buf and arr when done.
 //
-static char **parse_path(const char *path) {
+static char **parse_path_r(const char *path, char *&buf, int &bufsize,
+                           char **&arr, int &arrsize) {
   while ( *path == '/' ) path++;	// skip leading '/' 
+  int len = strlen(path) + 1;
+  if ( len > bufsize ) {
+    bufsize = len;
+    buf = (char*)realloc(buf, bufsize);
+  }
   // First pass: identify, null terminate, and count separators
   int seps = 1;				// separator count (1: first item)
-  int arrsize = 1;			// array size (1: first item)
-  char *save = strdup(path);		// make copy we can modify
-  char *sin = save, *sout = save;
+  char *sout = buf;
+  const char *sin = path;
   while ( *sin ) {
     if ( *sin == '\\' ) {		// handle escape character
       *sout++ = *++sin;
@@ -58,25 +65,37 @@ static char **parse_path(const char *path) {
       *sout++ = 0;
       sin++;
       seps++;
-      arrsize++;
     } else {				// all other chars
       *sout++ = *sin++;
     }
   }
   *sout = 0;
-  arrsize++;				// (room for terminating NULL) 
-  // Second pass: create array, save nonblank elements
-  char **arr = (char**)malloc(sizeof(char*) * arrsize);
+  // Second pass: fill array, save nonblank elements
+  if ( seps + 1 > arrsize ) {		// (room for terminating NULL)
+    arrsize = seps + 1;
+    arr = (char**)realloc(arr, sizeof(char*) * arrsize);
+  }
   int t = 0;
-  sin = save;
+  char *s = buf;
   while ( seps-- > 0 ) {
-    if ( *sin ) { arr[t++] = sin; }	// skips empty fields, e.g. '//'
-    sin += (strlen(sin) + 1);
+    if ( *s ) { arr[t++] = s; }		// skips empty fields, e.g. '//'
+    s += (strlen(s) + 1);
   }
   arr[t] = 0;
   return(arr);
 }
 
+// INTERNAL: Parse elements from path into an array of null terminated strings
+//    Caller must call free_path(arr).
+//
+static char **parse_path(const char *path) {
+  char *buf = 0, **arr = 0;
+  int bufsize = 0, arrsize = 0;
+  parse_path_r(path, buf, bufsize, arr, arrsize);
+  if ( ! arr[0] ) free((void*)buf);	// free_path() frees arr[0]
+  return(arr);
+}
+
 // INTERNAL: Free the array returned by parse_path()
 static void free_path(char **arr) {
   if ( arr ) {
@@ -145,6 +164,57 @@ Fl_Tree_Item* Fl_Tree::add(const char *path) {
   return(item);
 }
 
+/// Adds many items at once, given an array of \p npaths 'menu style' paths.
+///
+/// This is the same as calling add(const char*) for each path, but faster
+/// for large numbers of items: the paths are parsed into one buffer that
+/// is reused, and when a path starts with the same parents as the path
+/// before it (e.g. when the paths are sorted), those parents are not
+/// looked up again. Loading a large tree this way takes linear time.
+///
+/// \code
+///     const char *paths[] = { "/Fruit/Apple", "/Fruit/Banana", "/Vegetables/Leek" };
+///     tree->add(paths, 3);
+/// \endcode
+///
+/// \returns the number of paths for which an item was added or found.
+///
+int Fl_Tree::add(const char * const *paths, int npaths) {
+  if ( ! _root ) {					// Create root if none
+    _root = new Fl_Tree_Item(_prefs);
+    _root->parent(0);
+    _root->label("ROOT");
+  }
+  char *buf = 0, **arr = 0;
+  int bufsize = 0, arrsize = 0;
+  Fl_Tree_Item **chain = 0;			// items of the previous path
+  int chainlen = 0, chainsize = 0;
+  int count = 0;
+  for ( int n=0; n<npaths; n++ ) {
+    parse_path_r(paths[n], buf, bufsize, arr, arrsize);
+    if ( ! arr[0] ) continue;			// empty path
+    // Reuse the parents shared with the previous path
+    int t = 0;
+    while ( t < chainlen && arr[t] && strcmp(chain[t]->label(), arr[t]) == 0 ) t++;
+    Fl_Tree_Item *item = t ? chain[t-1] : _root;
+    for ( ; arr[t]; t++ ) {
+      Fl_Tree_Item *c = item->find_child_item(arr[t]);
+      item = c ? c : item->add(_prefs, arr[t]);
+      if ( t >= chainsize ) {
+        chainsize = chainsize ? chainsize * 2 : 16;
+        chain = (Fl_Tree_Item**)realloc(chain, sizeof(Fl_Tree_Item*) * chainsize);
+      }
+      chain[t] = item;
+    }
+    chainlen = t;
+    count++;
+  }
+  free((void*)buf);
+  free((void*)arr);
+  free((void*)chain);
+  return(count);
+}
+
 /// Inserts a new item above the specified Fl_Tree_Item, with the label set to 'name'.
 /// \param[in] above -- the item above which to insert the new item. Must not be NULL.
 /// \param[in] name -- the name of the new item
@@ -595,8 +665,8 @@ int Fl_Tree::handle(int e) {
 	      set_item_focus(next_visible_item(_item_focus, ekey));	// next item up|dn
 	      if ( _item_focus ) {					// item in focus?
 	        // Autoscroll
-		int itemtop = _item_focus->y();
-		int itembot = _item_focus->y()+_item_focus->h();
+		int itemtop = item_y(_item_focus);
+		int itembot = itemtop + _item_focus->row_height(_prefs);
 		if ( itemtop < y() ) { show_item_top(_item_focus); }
 		if ( itembot > y()+h() ) { show_item_bottom(_item_focus); }
 		// Extend selection
@@ -825,7 +895,7 @@ int Fl_Tree::select_only(Fl_Tree_Item *selitem, int docallback) {
 void Fl_Tree::show_item(Fl_Tree_Item *item, int yoff) {
   item = item ? item : first();
   if (!item) return;
-  int newval = item->y() - y() - yoff + (int)_vscroll->value();
+  int newval = item_y(item) - y() - yoff + (int)_vscroll->value();
   if ( newval < _vscroll->minimum() ) newval = (int)_vscroll->minimum();
   if ( newval > _vscroll->maximum() ) newval = (int)_vscroll->maximum();
   _vscroll->value(newval);
@@ -844,7 +914,16 @@ void Fl_Tree::show_item(Fl_Tree_Item *item, int yoff) {
 int Fl_Tree::displayed(Fl_Tree_Item *item) {
   item = item ? item : first();
   if (!item) return(0);
-  return( (item->y() >= y()) && (item->y() <= (y()+h()-item->h())) ? 1 : 0);
+  int itemy = item_y(item);
+  return( (itemy >= y()) && (itemy <= (y()+h()-item->row_height(_prefs))) ? 1 : 0);
+}
+
+// Internal: Return where the top of \p item is drawn for the current scroll
+// position. Unlike item->y(), this is also correct for items not on screen.
+//
+int Fl_Tree::item_y(const Fl_Tree_Item *item) const {
+  return(y() + Fl::box_dy(box()) + _prefs.margintop() + item->row_offset(_prefs)
+         - (_vscroll->visible() ? (int)_vscroll->value() : 0));
 }
 
 /// Adjust the vertical scroll bar to show \p item at the top
@@ -877,7 +956,7 @@ void Fl_Tree::show_item_top(Fl_Tree_Item *item) {
 ///
 void Fl_Tree::show_item_middle(Fl_Tree_Item *item) {
   item = item ? item : first();
-  if (item) show_item(item, (h()/2)-(item->h()/2));
+  if (item) show_item(item, (h()/2)-(item->row_height(_prefs)/2));
 }
 
 /// Adjust the vertical scrollbar so that \p item is at the bottom of the display.
@@ -886,7 +965,7 @@ void Fl_Tree::show_item_middle(Fl_Tree_Item *item) {
 ///
 void Fl_Tree::show_item_bottom(Fl_Tree_Item *item) {
   item = item ? item : first();
-  if (item) show_item(item, h()-item->h());
+  if (item) show_item(item, h()-item->row_height(_prefs));
 }
 
 /// Returns the vertical scroll position as a pixel offset.
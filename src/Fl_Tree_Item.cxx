@@ -5,7 +5,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <FL/Fl_Widget.H>
+#include <FL/Fl_Group.H>
 #include <FL/Fl_Tree_Item.H>
 #include <FL/Fl_Tree_Prefs.H>
 
@@ -63,6 +65,9 @@ Fl_Tree_Item::Fl_Tree_Item(const Fl_Tree_Prefs &prefs) {
   _label_xywh[1]    = 0;
   _label_xywh[2]    = 0;
   _label_xywh[3]    = 0;
+  _height           = -1;
+  _child_y          = 0;
+  _child_y_size     = 0;
   _usericon         = 0;
   _userdata         = 0;
   _parent           = 0;
@@ -76,6 +81,7 @@ Fl_Tree_Item::~Fl_Tree_Item() {
   }
   _widget = 0;			// Fl_Group will handle destruction
   _usericon = 0;		// user handled allocation
+  delete[] _child_y;
   //_children.clear();		// array's destructor handles itself
 }
 
@@ -103,6 +109,9 @@ Fl_Tree_Item::Fl_Tree_Item(const Fl_Tree_Item *o) {
   _label_xywh[1]    = o->_label_xywh[1];
   _label_xywh[2]    = o->_label_xywh[2];
   _label_xywh[3]    = o->_label_xywh[3];
+  _height           = -1;
+  _child_y          = 0;
+  _child_y_size     = 0;
   _usericon         = o->usericon();
   _userdata         = o->user_data();
   _parent           = o->_parent;
@@ -131,6 +140,7 @@ void Fl_Tree_Item::show_self(const char *indent) const {
 void Fl_Tree_Item::label(const char *name) {
   if ( _label ) { free((void*)_label); _label = 0; }
   _label = name ? strdup(name) : 0;
+  if ( _parent ) _parent->_children.labels_changed();	// parent's lookup of us by name
 }
 
 /// Return the label.
@@ -146,6 +156,7 @@ const Fl_Tree_Item *Fl_Tree_Item::child(int index) const {
 /// Clear all the children for this item.
 void Fl_Tree_Item::clear_children() {
   _children.clear();
+  height_changed();
 }
 
 /// Return the index of the immediate child of this item that has the label 'name'.
@@ -153,16 +164,24 @@ void Fl_Tree_Item::clear_children() {
 /// \returns index of found item, or -1 if not found.
 ///
 int Fl_Tree_Item::find_child(const char *name) {
-  if ( name ) {
-    for ( int t=0; t<children(); t++ ) {
-      if ( child(t)->label() ) {
-        if ( strcmp(child(t)->label(), name) == 0 ) {
-          return(t);
-        }
-      }
-    }
-  }
-  return(-1);
+  Fl_Tree_Item *item = find_child_item(name);
+  return(item ? find_child(item) : -1);
+}
+
+/// Return the first immediate child of this item that has the label 'name'.
+///
+/// Items with many children keep a hash table of their labels,
+/// so this is fast even for large trees.
+///
+/// \returns the child, or 0 if not found.
+///
+const Fl_Tree_Item *Fl_Tree_Item::find_child_item(const char *name) const {
+  return(_children.find(name));
+}
+
+/// Non-const version of find_child_item(const char*) const.
+Fl_Tree_Item *Fl_Tree_Item::find_child_item(const char *name) {
+  return(_children.find(name));
 }
 
 /// Find child item by descending array of names. Does not include self in search.
@@ -171,18 +190,11 @@ int Fl_Tree_Item::find_child(const char *name) {
 /// \returns item, or 0 if not found
 ///
 const Fl_Tree_Item *Fl_Tree_Item::find_child_item(char **arr) const {
-  for ( int t=0; t<children(); t++ ) {
-    if ( child(t)->label() ) {
-      if ( strcmp(child(t)->label(), *arr) == 0 ) {	// match?
-        if ( *(arr+1) ) {				// more in arr? descend
-          return(_children[t]->find_item(arr+1));
-        } else {					// end of arr? done
-          return(_children[t]);
-        }
-      }
-    }
+  const Fl_Tree_Item *item = find_child_item(*arr);
+  if ( item && *(arr+1) ) {			// more in arr? descend
+    return(item->find_item(arr+1));
   }
-  return(0);
+  return(item);					// end of arr? done
 }
 
 /// Find child item by descending array of names. Does not include self in search.
@@ -191,18 +203,11 @@ const Fl_Tree_Item *Fl_Tree_Item::find_child_item(char **arr) const {
 /// \returns item, or 0 if not found
 ///
 Fl_Tree_Item *Fl_Tree_Item::find_child_item(char **arr) {
-  for ( int t=0; t<children(); t++ ) {
-    if ( child(t)->label() ) {
-      if ( strcmp(child(t)->label(), *arr) == 0 ) {	// match?
-        if ( *(arr+1) ) {				// more in arr? descend
-          return(_children[t]->find_item(arr+1));
-        } else {					// end of arr? done
-          return(_children[t]);
-        }
-      }
-    }
+  Fl_Tree_Item *item = find_child_item(*arr);
+  if ( item && *(arr+1) ) {			// more in arr? descend
+    return(item->find_item(arr+1));
   }
-  return(0);
+  return(item);					// end of arr? done
 }
 
 /// Find item by descending array of \p names. Includes self in search.
@@ -261,6 +266,7 @@ Fl_Tree_Item *Fl_Tree_Item::add(const Fl_Tree_Prefs &prefs, const char *new_labe
   Fl_Tree_Item *item = new Fl_Tree_Item(prefs);
   item->label(new_label);
   item->_parent = this;
+  height_changed();
   switch ( prefs.sortorder() ) {
     case FL_TREE_SORT_NONE: {
       _children.add(item);
@@ -298,12 +304,9 @@ Fl_Tree_Item *Fl_Tree_Item::add(const Fl_Tree_Prefs &prefs, const char *new_labe
 /// \returns the item added.
 ///
 Fl_Tree_Item *Fl_Tree_Item::add(const Fl_Tree_Prefs &prefs, char **arr) {
-  int t = find_child(*arr);
-  Fl_Tree_Item *item = 0;
-  if ( t == -1 ) {
-    item = (Fl_Tree_Item*)add(prefs, *arr);
-  } else {
-    item = (Fl_Tree_Item*)child(t);
+  Fl_Tree_Item *item = find_child_item(*arr);
+  if ( ! item ) {
+    item = add(prefs, *arr);
   }
   if ( *(arr+1) ) {		// descend?
     return(item->add(prefs, arr+1));
@@ -320,6 +323,7 @@ Fl_Tree_Item *Fl_Tree_Item::insert(const Fl_Tree_Prefs &prefs, const char *new_l
   item->label(new_label);
   item->_parent = this;
   _children.insert(pos, item);
+  height_changed();
   return(item);
 }
 
@@ -347,6 +351,7 @@ int Fl_Tree_Item::remove_child(Fl_Tree_Item *item) {
     if ( child(t) == item ) {
       item->clear_children();
       _children.remove(t);
+      height_changed();
       return(0);
     }
   }
@@ -361,6 +366,7 @@ int Fl_Tree_Item::remove_child(const char *name) {
     if ( child(t)->label() ) {
       if ( strcmp(child(t)->label(), name) == 0 ) {
         _children.remove(t);
+        height_changed();
         return(0);
       }
     }
@@ -381,6 +387,7 @@ int Fl_Tree_Item::remove_child(const char *name) {
 ///
 void Fl_Tree_Item::swap_children(int ax, int bx) {
   _children.swap(ax, bx);
+  height_changed();
 }
 
 /// Swap two of our children, given item pointers.
@@ -458,6 +465,7 @@ void Fl_Tree_Item::draw_vertical_connector(int x, int y1, int y2, const Fl_Tree_
 ///
 const Fl_Tree_Item *Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs &prefs) const {
   if ( ! _visible ) return(0);
+  int Y = _xywh[1];
   if ( is_root() && !prefs.showroot() ) {
     // skip event check if we're root but root not being shown
   } else {
@@ -465,13 +473,16 @@ const Fl_Tree_Item *Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs &prefs) const
     if ( event_inside(_xywh) ) {		// event within this item?
       return(this);				// found
     }
+    Y += _xywh[3];
   }
-  if ( is_open() ) {				// open? check children of this item
-    for ( int t=0; t<children(); t++ ) {
-      const Fl_Tree_Item *item;
-      if ( ( item = _children[t]->find_clicked(prefs) ) != NULL) {	// check child and its descendents
-        return(item);							// found?
-      }
+  if ( has_children() && is_open() && Fl::event_y() >= Y ) {	// open? check children of this item
+    // Only the child whose rows span the event can hold it. Its xywh is
+    // only current if it was drawn, ie. if it starts where we expect.
+    int t = child_at(Fl::event_y() - Y, prefs);
+    if ( t < children() ) {
+      const Fl_Tree_Item *c = child(t);
+      Y += _child_y[t];
+      return(c->_xywh[1] == Y ? c->find_clicked(prefs) : 0);
     }
   }
   return(0);
@@ -487,24 +498,7 @@ const Fl_Tree_Item *Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs &prefs) const
 ///    \returns the visible item under the event if found, or 0 if none.
 ///
 Fl_Tree_Item *Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs &prefs) {
-  if ( ! _visible ) return(0);
-  if ( is_root() && !prefs.showroot() ) {
-    // skip event check if we're root but root not being shown
-  } else {
-    // See if event is over us
-    if ( event_inside(_xywh) ) {		// event within this item?
-      return(this);				// found
-    }
-  }
-  if ( is_open() ) {				// open? check children of this item
-    for ( int t=0; t<children(); t++ ) {
-      Fl_Tree_Item *item;
-      if ( ( item = _children[t]->find_clicked(prefs) ) != NULL ) {	// check child and its descendents
-        return(item);							// found?
-      }
-    }
-  }
-  return(0);
+  return((Fl_Tree_Item*)((const Fl_Tree_Item*)this)->find_clicked(prefs));
 }
 
 static void draw_item_focus(Fl_Boxtype B, Fl_Color C, int X, int Y, int W, int H) {
@@ -547,15 +541,30 @@ static void draw_item_focus(Fl_Boxtype B, Fl_Color C, int X, int Y, int W, int H
 #endif
 }
 
+// Items with widgets have to be drawn to keep their widgets in place,
+// so subtrees are only skipped if the tree has no children but its scrollbar.
+static int can_skip(Fl_Widget *tree) {
+  Fl_Group *g = tree->as_group();
+  return(g && g->children() <= 1);
+}
+
 /// Draw this item and its children.
+///
+/// Subtrees that are entirely outside the clip region are skipped,
+/// only advancing Y by their height, and the children on screen are
+/// found by a binary search, so drawing takes time in proportion to
+/// the visible rows and the depth of the tree.
+///
 void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Widget *tree,
 			Fl_Tree_Item *itemfocus,
                         const Fl_Tree_Prefs &prefs, int lastchild) {
   if ( ! _visible ) return; 
-  fl_font(_labelfont, _labelsize);
-  int H = _labelsize;
-  if(usericon() && H < usericon()->h()) H = usericon()->h(); 
-  H += prefs.linespacing() + fl_descent();
+  int HT = subtree_height(prefs);
+  if ( !fl_not_clipped(X, Y, W, HT) && can_skip(tree) ) {
+    Y += HT;
+    return;
+  }
+  int H = row_height(prefs);		// also sets the label font
   // adjust horizontally if we draw no connecting lines
   if ( is_root() && prefs.connectorstyle() == FL_TREE_CONNECTOR_NONE ) {
     X -= prefs.openicon()->w();
@@ -685,10 +694,24 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Widget *tree,
     (hcenterx - (icon_w/2) + 1) : X;			// unless didn't drawthis
     int child_w = W - (child_x-X);
     int child_y_start = Y;
-    for ( int t=0; t<children(); t++ ) {
-      int lastchild = ((t+1)==children()) ? 1 : 0;
+    int n = children(), t = 0, bottom = INT_MAX;
+    if ( can_skip(tree) ) {
+      // Only draw the children from the one at the top of the clip
+      // region to the one at its bottom, the others just take up space.
+      int cx, cy, cw, ch;
+      fl_clip_box(child_x, Y, child_w, _child_y[n], cx, cy, cw, ch);
+      if ( ch <= 0 ) {
+        t = n;
+      } else {
+        t = child_at(cy - Y, prefs);
+        bottom = cy + ch;
+      }
+    }
+    for ( Y = child_y_start + _child_y[t]; t<n && Y<bottom; t++ ) {
+      int lastchild = ((t+1)==n) ? 1 : 0;
       _children[t]->draw(child_x, Y, child_w, tree, itemfocus, prefs, lastchild);
     }
+    Y = child_y_start + _child_y[n];
     if ( has_children() && is_open() ) {
       Y += prefs.openchild_marginbottom();		// offset below open child tree
     }
@@ -698,6 +721,97 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Widget *tree,
   }
 }
 
+/// Return the height of this item's own row.
+int Fl_Tree_Item::row_height(const Fl_Tree_Prefs &prefs) const {
+  fl_font(_labelfont, _labelsize);
+  int H = _labelsize;
+  if(usericon() && H < usericon()->h()) H = usericon()->h(); 
+  return(H + prefs.linespacing() + fl_descent());
+}
+
+/// Return the height of this item and all its open children, as drawn.
+///
+/// The height is cached, and recalculated when the item or one of
+/// its children changes in a way that affects it.
+///
+int Fl_Tree_Item::subtree_height(const Fl_Tree_Prefs &prefs) const {
+  if ( ! _visible ) return(0);
+  if ( _height < 0 ) {
+    int H = ( is_root() && prefs.showroot() == 0 ) ? 0 : row_height(prefs);
+    if ( has_children() && is_open() ) {
+      // Keep where each child starts, so draw() and find_clicked()
+      // can go straight to the children at a given height.
+      int n = children();
+      if ( _child_y_size < n+1 ) {
+        delete[] _child_y;
+        _child_y = new int[n+1];
+        _child_y_size = n+1;
+      }
+      int CH = 0;
+      for ( int t=0; t<n; t++ ) {
+        _child_y[t] = CH;
+        CH += child(t)->subtree_height(prefs);
+      }
+      _child_y[n] = CH;
+      H += CH + prefs.openchild_marginbottom();
+    }
+    _height = H;
+  }
+  return(_height);
+}
+
+/// Internal: Return the index of the open child whose rows span \p dy,
+/// measured from the top of the first child, or children() if \p dy is
+/// below the last one. Binary searches the cached child positions.
+///
+int Fl_Tree_Item::child_at(int dy, const Fl_Tree_Prefs &prefs) const {
+  subtree_height(prefs);			// makes sure _child_y is current
+  int lo = 0, hi = children();
+  while ( lo < hi ) {
+    int mid = (lo + hi) / 2;
+    if ( _child_y[mid+1] > dy ) hi = mid;
+    else lo = mid + 1;
+  }
+  return(lo);
+}
+
+/// Return the distance in pixels from the top of the tree to the top of
+/// this item, whether or not the item is on screen.
+///
+int Fl_Tree_Item::row_offset(const Fl_Tree_Prefs &prefs) const {
+  int Y = 0;
+  const Fl_Tree_Item *item = this;
+  const Fl_Tree_Item *p;
+  while ( ( p = item->parent() ) != 0 ) {
+    if ( ! ( p->is_root() && prefs.showroot() == 0 ) ) {
+      Y += p->row_height(prefs);
+    }
+    for ( int t=0; t<p->children() && p->child(t) != item; t++ ) {
+      Y += p->child(t)->subtree_height(prefs);
+    }
+    item = p;
+  }
+  return(Y);
+}
+
+/// Internal: Forget the cached height of this item and its parents.
+void Fl_Tree_Item::height_changed() {
+  // a parent of an item without a height has none either
+  for ( Fl_Tree_Item *item = this; item && item->_height >= 0; item = item->_parent ) {
+    item->_height = -1;
+  }
+}
+
+/// Forget the cached heights of this item and all its children.
+/// Used when a tree preference that affects item heights changes.
+///
+void Fl_Tree_Item::invalidate_heights() {
+  _height = -1;
+  for ( int t=0; t<_children.total(); t++ ) {
+    _children[t]->invalidate_heights();
+  }
+}
+
 /// Was the event on the 'collapse' button?
 ///
 int Fl_Tree_Item::event_on_collapse_icon(const Fl_Tree_Prefs &prefs) const {
@@ -743,6 +857,7 @@ void Fl_Tree_Item::hide_widgets() {
 /// Open this item and all its children.
 void Fl_Tree_Item::open() {
   _open = 1;
+  height_changed();
   // Tell children to show() their widgets
   for ( int t=0; t<_children.total(); t++ ) {
     _children[t]->show_widgets();
@@ -752,6 +867,7 @@ void Fl_Tree_Item::open() {
 /// Close this item and all its children.
 void Fl_Tree_Item::close() {
   _open = 0;
+  height_changed();
   // Tell children to hide() their widgets
   for ( int t=0; t<_children.total(); t++ ) {
     _children[t]->hide_widgets();
@@ -42,6 +42,10 @@ Fl_Tree_Item_Array::Fl_Tree_Item_Array(int new_chunksize) {
   _total     = 0;
   _size      = 0;
   _chunksize = new_chunksize;
+  _hash      = 0;
+  _hashsize  = 0;
+  _hashused  = 0;
+  _hashdups  = 0;
 }
 
 /// Destructor. Calls each item's destructor, destroys internal _items array.
@@ -55,6 +59,10 @@ Fl_Tree_Item_Array::Fl_Tree_Item_Array(const Fl_Tree_Item_Array* o) {
   _total     = o->_total;
   _size      = o->_size;
   _chunksize = o->_chunksize;
+  _hash      = 0;			// built again when needed
+  _hashsize  = 0;
+  _hashused  = 0;
+  _hashdups  = 0;
   for ( int t=0; t<o->_total; t++ ) {
     _items[t] = new Fl_Tree_Item(o->_items[t]);
   }
@@ -74,18 +82,24 @@ void Fl_Tree_Item_Array::clear() {
     free((void*)_items); _items = 0;
   }
   _total = _size = 0;
+  labels_changed();
 }
 
 // Internal: Enlarge the items array.
 //
 //    Adjusts size/items memory allocation as needed.
 //    Does NOT change total.
+//    Grows by half the current size (at least _chunksize), so that
+//    adding many items takes linear time.
 //
 void Fl_Tree_Item_Array::enlarge(int count) {
   int newtotal = _total + count;	// new total
   if ( newtotal >= _size ) {		// more than we have allocated?
     // Increase size of array
-    int newsize = _size + _chunksize;
+    int grow = _size / 2;
+    if ( grow < _chunksize ) grow = _chunksize;
+    int newsize = _size + grow;
+    if ( newsize <= newtotal ) newsize = newtotal + 1;
     Fl_Tree_Item **newitems = (Fl_Tree_Item**)malloc(newsize * sizeof(Fl_Tree_Item*));
     if ( _items ) { 
       // Copy old array -> new, delete old
@@ -112,6 +126,16 @@ void Fl_Tree_Item_Array::insert(int pos, Fl_Tree_Item *new_item) {
   } 
   _items[pos] = new_item;
   _total++;
+  if ( _hash && new_item->label() ) {
+    const Fl_Tree_Item *same = find(new_item->label());
+    if ( same && pos < _total-1 ) {
+      labels_changed();			// may now be ahead of the item in the table
+    } else if ( (_hashused+1)*2 > _hashsize ) {
+      build_hash();
+    } else {
+      hash_add(new_item);
+    }
+  }
 }
 
 /// Add an item* to the end of the array.
@@ -130,6 +154,7 @@ void Fl_Tree_Item_Array::add(Fl_Tree_Item *val) {
 ///
 void Fl_Tree_Item_Array::remove(int index) {
   if ( _items[index] ) {		// delete if non-zero
+    if ( _hash ) hash_remove(_items[index]);
     delete _items[index];
   }
   _items[index] = 0;
@@ -152,6 +177,134 @@ int Fl_Tree_Item_Array::remove(Fl_Tree_Item *item) {
   return(-1);
 }
 
+/// Swap the two items at index positions \p ax and \p bx.
+void Fl_Tree_Item_Array::swap(int ax, int bx) {
+  Fl_Tree_Item *asave = _items[ax];
+  _items[ax] = _items[bx];
+  _items[bx] = asave;
+  if ( _hash && _items[ax]->label() && _items[bx]->label() &&
+       strcmp(_items[ax]->label(), _items[bx]->label()) == 0 ) {
+    labels_changed();			// which one comes first has changed
+  }
+}
+
+// Internal: hash function for the labels
+static unsigned hash_label(const char *s) {
+  unsigned h = 2166136261U;		// FNV-1a
+  while ( *s ) {
+    h ^= (unsigned char)*s++;
+    h *= 16777619U;
+  }
+  return(h);
+}
+
+// Internal: (Re)build the hash table from the items.
+//
+//    Sized to be at most half full, so that probe sequences stay short.
+//
+void Fl_Tree_Item_Array::build_hash() const {
+  if ( _hash ) free((void*)_hash);
+  for ( _hashsize = 64; _hashsize < (_total+1)*2; _hashsize *= 2 ) { }
+  _hash = (Fl_Tree_Item**)calloc(_hashsize, sizeof(Fl_Tree_Item*));
+  _hashused = 0;
+  _hashdups = 0;
+  for ( int t=0; t<_total; t++ ) {
+    hash_add(_items[t]);
+  }
+}
+
+// Internal: Add an item to the hash table.
+//
+//    If an item with the same label is already there, it is kept,
+//    since find() has to return the first one.
+//
+void Fl_Tree_Item_Array::hash_add(Fl_Tree_Item *item) const {
+  const char *name = item->label();
+  if ( ! name ) return;
+  unsigned mask = _hashsize - 1;
+  unsigned i;
+  for ( i = hash_label(name) & mask; _hash[i]; i = (i+1) & mask ) {
+    if ( strcmp(_hash[i]->label(), name) == 0 ) {
+      _hashdups = 1;
+      return;
+    }
+  }
+  _hash[i] = item;
+  _hashused++;
+}
+
+// Internal: Remove an item from the hash table, if it is in it.
+void Fl_Tree_Item_Array::hash_remove(Fl_Tree_Item *item) {
+  const char *name = item->label();
+  if ( ! name ) return;
+  unsigned mask = _hashsize - 1;
+  unsigned i;
+  for ( i = hash_label(name) & mask; _hash[i] != item; i = (i+1) & mask ) {
+    if ( ! _hash[i] ) return;		// not in table (a duplicate)
+  }
+  if ( _hashdups ) {			// another item may have the label
+    labels_changed();
+    return;
+  }
+  // Remove, and move up the entries that probed past it
+  _hash[i] = 0;
+  _hashused--;
+  for ( unsigned j = (i+1) & mask; _hash[j]; j = (j+1) & mask ) {
+    unsigned k = hash_label(_hash[j]->label()) & mask;
+    if ( ( i <= j ) ? ( k <= i || k > j ) : ( k <= i && k > j ) ) {
+      _hash[i] = _hash[j];
+      _hash[j] = 0;
+      i = j;
+    }
+  }
+}
+
+/// Find the first item whose label is \p name.
+///
+///     Arrays with more than FL_TREE_ITEM_HASH_MIN items use a hash table.
+///
+///     \returns the item, or 0 if none has that label.
+///
+const Fl_Tree_Item *Fl_Tree_Item_Array::find(const char *name) const {
+  if ( ! name ) return(0);
+  if ( ! _hash ) {
+    if ( _total <= FL_TREE_ITEM_HASH_MIN ) {	// small? just search
+      for ( int t=0; t<_total; t++ ) {
+        if ( _items[t]->label() && strcmp(_items[t]->label(), name) == 0 ) {
+          return(_items[t]);
+        }
+      }
+      return(0);
+    }
+    build_hash();
+  }
+  unsigned mask = _hashsize - 1;
+  for ( unsigned i = hash_label(name) & mask; _hash[i]; i = (i+1) & mask ) {
+    if ( strcmp(_hash[i]->label(), name) == 0 ) {
+      return(_hash[i]);
+    }
+  }
+  return(0);
+}
+
+/// Non-const version of find(const char*) const.
+Fl_Tree_Item *Fl_Tree_Item_Array::find(const char *name) {
+  return((Fl_Tree_Item*)((const Fl_Tree_Item_Array*)this)->find(name));
+}
+
+/// Tell the array that the label of one of its items has changed.
+///
+///     Drops the hash table, which is built again when needed.
+///
+void Fl_Tree_Item_Array::labels_changed() {
+  if ( _hash ) {
+    free((void*)_hash);
+    _hash = 0;
+  }
+  _hashsize = _hashused = 0;
+  _hashdups = 0;
+}
+
 //
 // End of "$Id: Fl_Tree_Item_Array.cxx 7903 2010-11-28 21:06:39Z matt $".
 //
@@ -139,6 +139,7 @@ Fl_Widget::Fl_Widget(int X, int Y, int W, int H, const char* L) {
 
 void Fl_Widget::resize(int X, int Y, int W, int H) {
   x_ = X; y_ = Y; w_ = W; h_ = H;
+  if (parent_) parent_->index_child(this);
 }
 
 // this is useful for parent widgets to call to resize children:
@@ -159,6 +160,8 @@ int Fl_Widget::take_focus() {
 }
 
 extern void fl_throw_focus(Fl_Widget*); // in Fl_x.cxx
+extern void fl_shortcut_unregister(Fl_Widget*); // in fl_shortcut.cxx
+extern void fl_shortcut_register_label(Fl_Widget*, int);
 
 /**
    Destroys the widget, taking care of throwing focus before if any.
@@ -167,6 +170,7 @@ extern void fl_throw_focus(Fl_Widget*); // in Fl_x.cxx
 */
 Fl_Widget::~Fl_Widget() {
   Fl::clear_widget_pointer(this);
+  fl_shortcut_unregister(this);
   if (flags() & COPIED_LABEL) free((void *)(label_.value));
   if (flags() & COPIED_TOOLTIP) free((void *)(tooltip_));
   // remove from parent group
@@ -231,6 +235,7 @@ void Fl_Widget::show() {
   if (!visible()) {
     clear_flag(INVISIBLE);
     if (visible_r()) {
+      Fl_Group::uncache(this);
         damage( FL_DAMAGE_EXPOSE );
 //      redraw_label();
       handle(FL_SHOW);
@@ -242,6 +247,7 @@ void Fl_Widget::show() {
 void Fl_Widget::hide() {
   if (visible_r()) {
     set_flag(INVISIBLE);
+    Fl_Group::uncache(this);
     for (Fl_Widget *p = parent(); p; p = p->parent())
       if (p->box() || !p->parent()) {p->redraw(); break;}
     handle(FL_HIDE);
@@ -277,6 +283,7 @@ Fl_Widget::label(const char *a) {
   if ( ( !a || !label_.value ) || strcmp( a, label_.value ) )
       redraw_label();
   label_.value=a;
+  fl_shortcut_register_label(this, flags() & SHORTCUT_LABEL);
 }
 
 
@@ -294,7 +301,7 @@ Fl_Widget::copy_label(const char *a) {
     clear_flag(COPIED_LABEL);
     label_.value=(char *)0;
   }
-
+  fl_shortcut_register_label(this, flags() & SHORTCUT_LABEL);
 }
 
 /** Calls the widget callback.
@@ -59,6 +59,9 @@ void Fl_Window::_Fl_Window() {
   resizable(0);
   size_range_set = 0;
   minw = maxw = minh = maxh = 0;
+  frame_interval_ = 0;
+  frame_last_ = frame_pending_ = 0;
+  frame_missed_ = 0;
   callback((Fl_Callback*)default_callback);
 }
 
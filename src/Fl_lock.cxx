@@ -67,58 +67,221 @@
    returns the most recent value!
 */
 
-#ifndef FL_DOXYGEN
-Fl_Awake_Handler *Fl::awake_ring_;
-void **Fl::awake_data_;
-int Fl::awake_ring_size_;
-int Fl::awake_ring_head_;
-int Fl::awake_ring_tail_;
-#endif
-
-static const int AWAKE_RING_SIZE = 1024;
-static void lock_ring();
-static void unlock_ring();
+/*
+   The awake queue.
+
+   Fl::awake(Fl_Awake_Handler, void*) may be called from any number of
+   threads (including realtime ones), while the handlers are only ever
+   run by the main thread. The queue is therefore a bounded
+   multi-producer/single-consumer ring which never takes a lock:
+
+   - Each cell carries a sequence number. A producer claims a cell by
+     advancing the enqueue position with a single compare-and-swap and
+     publishes it by storing the cell's new sequence number. It only
+     has to retry when another producer claimed the same cell first,
+     and it never waits on the consumer: when the ring is full the
+     message is dropped, counted, and -1 is returned immediately.
+
+   - The consumer (the main thread) copies a batch of published cells
+     out of the ring and releases them before any handler is called,
+     so handlers may safely post new messages.
+
+   - The main thread is woken only when the queue goes from idle to
+     busy, so a burst of messages costs a single wakeup.
+
+   The sequence numbers are stored relative to the cell index, which
+   lets the ring live in zero-initialized static storage and needs no
+   run-time setup that could race with the first producer.
+*/
 
+static const unsigned AWAKE_RING_SIZE = 1024; // must be a power of two
+static const unsigned AWAKE_RING_MASK = AWAKE_RING_SIZE - 1;
 
-/** Adds an awake handler for use in awake(). */
+struct Fl_Awake_Cell {
+  unsigned seq;                 // sequence number minus cell index
+  Fl_Awake_Handler func;
+  void *data;
+};
+
+static Fl_Awake_Cell awake_ring[AWAKE_RING_SIZE];
+static unsigned awake_enqueue_pos;
+static unsigned awake_dequeue_pos;
+static unsigned awake_pending;  // non-zero when a wakeup has been sent
+static unsigned awake_drops;
+static unsigned awake_high_water;
+static int awake_coalesce_;
+
+// messages taken from the ring but not yet handed out
+static Fl_Awake_Cell awake_batch[AWAKE_RING_SIZE];
+static unsigned awake_batch_head;
+static unsigned awake_batch_tail;
+
+// used by the consumer to find duplicate func/data pairs in a batch
+static const unsigned AWAKE_HASH_SIZE = AWAKE_RING_SIZE * 2;
+static unsigned awake_hash_gen;
+static unsigned awake_hash_stamp[AWAKE_HASH_SIZE];
+static Fl_Awake_Cell awake_hash[AWAKE_HASH_SIZE];
+
+static void thread_message_cb(void *msg);
+
+#define fl_atomic_load( p ) __atomic_load_n( p, __ATOMIC_ACQUIRE )
+#define fl_atomic_store( p, v ) __atomic_store_n( p, v, __ATOMIC_RELEASE )
+#define fl_atomic_cas( p, e, v ) __atomic_compare_exchange_n( p, e, v, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED )
+
+/** Adds an awake handler for use in awake(). Returns -1 if the queue is full. */
 int Fl::add_awake_handler_(Fl_Awake_Handler func, void *data)
 {
-  int ret = 0;
-  lock_ring();
-  if (!awake_ring_) {
-    awake_ring_size_ = AWAKE_RING_SIZE;
-    awake_ring_ = (Fl_Awake_Handler*)malloc(awake_ring_size_*sizeof(Fl_Awake_Handler));
-    awake_data_ = (void**)malloc(awake_ring_size_*sizeof(void*));
+  unsigned pos = __atomic_load_n(&awake_enqueue_pos, __ATOMIC_RELAXED);
+  Fl_Awake_Cell *cell;
+
+  for (;;) {
+    cell = &awake_ring[pos & AWAKE_RING_MASK];
+    int diff = (int)(fl_atomic_load(&cell->seq) + (pos & AWAKE_RING_MASK) - pos);
+    if (diff == 0) {
+      // the cell is free, try to claim it
+      if (fl_atomic_cas(&awake_enqueue_pos, &pos, pos + 1))
+        break;
+      // lost the race, pos now holds the current position
+    } else if (diff < 0) {
+      // ring is full. Return -1 as an error indicator.
+      __atomic_add_fetch(&awake_drops, 1, __ATOMIC_RELAXED);
+      return -1;
+    } else
+      pos = __atomic_load_n(&awake_enqueue_pos, __ATOMIC_RELAXED);
   }
-  if (awake_ring_head_==awake_ring_tail_-1 || awake_ring_head_+1==awake_ring_tail_) {
-    // ring is full. Return -1 as an error indicator.
-    ret = -1;
-  } else {
-    awake_ring_[awake_ring_head_] = func;
-    awake_data_[awake_ring_head_] = data;
-    ++awake_ring_head_;
-    if (awake_ring_head_ == awake_ring_size_)
-      awake_ring_head_ = 0;
+
+  cell->func = func;
+  cell->data = data;
+  fl_atomic_store(&cell->seq, pos + 1 - (pos & AWAKE_RING_MASK));
+
+  unsigned depth = pos + 1 - fl_atomic_load(&awake_dequeue_pos);
+  unsigned hw = __atomic_load_n(&awake_high_water, __ATOMIC_RELAXED);
+  while (depth > hw && !fl_atomic_cas(&awake_high_water, &hw, depth))
+    ;
+
+  return 0;
+}
+
+// move everything published so far from the ring into the batch,
+// dropping repeated func/data pairs if coalescing is enabled
+static void fill_awake_batch()
+{
+  unsigned pos = awake_dequeue_pos;
+
+  awake_batch_head = awake_batch_tail = 0;
+
+  if (awake_coalesce_ && !++awake_hash_gen) {
+    // generation counter wrapped; invalidate all stamps
+    for (unsigned i = 0; i < AWAKE_HASH_SIZE; i++) awake_hash_stamp[i] = 0;
+    awake_hash_gen = 1;
+  }
+
+  for (;;) {
+    Fl_Awake_Cell *cell = &awake_ring[pos & AWAKE_RING_MASK];
+    int diff = (int)(fl_atomic_load(&cell->seq) + (pos & AWAKE_RING_MASK) - (pos + 1));
+    if (diff < 0) break;        // not yet published
+
+    Fl_Awake_Handler func = cell->func;
+    void *data = cell->data;
+
+    // hand the cell back to the producers
+    fl_atomic_store(&cell->seq, pos + AWAKE_RING_SIZE - (pos & AWAKE_RING_MASK));
+    pos++;
+    fl_atomic_store(&awake_dequeue_pos, pos);
+
+    if (awake_coalesce_ && func != thread_message_cb) {
+      unsigned h = (unsigned)(((unsigned long)func >> 3) ^ ((unsigned long)data >> 3) * 31);
+      bool dup = false;
+      for (;; h++) {
+        h &= AWAKE_HASH_SIZE - 1;
+        if (awake_hash_stamp[h] != awake_hash_gen) {
+          awake_hash_stamp[h] = awake_hash_gen;
+          awake_hash[h].func = func;
+          awake_hash[h].data = data;
+          break;
+        }
+        if (awake_hash[h].func == func && awake_hash[h].data == data) {
+          dup = true;
+          break;
+        }
+      }
+      if (dup) continue;
+    }
+
+    awake_batch[awake_batch_tail].func = func;
+    awake_batch[awake_batch_tail].data = data;
+    if (++awake_batch_tail == AWAKE_RING_SIZE) break;
   }
-  unlock_ring();
-  return ret;
 }
-/** Gets the last stored awake handler for use in awake(). */
+
+/** Gets the next stored awake handler for use in awake(). Must only be called by the main thread. */
 int Fl::get_awake_handler_(Fl_Awake_Handler &func, void *&data)
 {
-  int ret = 0;
-  lock_ring();
-  if (!awake_ring_ || awake_ring_head_ == awake_ring_tail_) {
-    ret = -1;
+  if (awake_batch_head == awake_batch_tail) {
+    // allow the next message to wake us up again
+    fl_atomic_store(&awake_pending, 0u);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    fill_awake_batch();
+    if (awake_batch_head == awake_batch_tail) return -1;
+  }
+
+  func = awake_batch[awake_batch_head].func;
+  data = awake_batch[awake_batch_head].data;
+  awake_batch_head++;
+  return 0;
+}
+
+// Messages sent by Fl::awake(void*) when the wakeup is an eventfd,
+// which carries no data. They pass through the awake queue and are
+// handed out by the main thread one per wakeup, as a pipe would.
+static void *thread_messages[AWAKE_RING_SIZE];
+static unsigned thread_messages_head;
+static unsigned thread_messages_tail;
+
+static void thread_message_cb(void *msg)
+{
+  if (thread_messages_tail - thread_messages_head == AWAKE_RING_SIZE) {
+    __atomic_add_fetch(&awake_drops, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  thread_messages[thread_messages_tail++ & AWAKE_RING_MASK] = msg;
+}
+
+/**
+  Enables or disables coalescing of awake handlers.
+
+  When enabled, identical handler/data pairs which are queued by
+  awake(Fl_Awake_Handler, void*) before the main thread gets to them
+  are only called once. This suits handlers which just refresh some
+  state (a meter, a transport display) and are posted at a much higher
+  rate than the screen is updated. Coalescing is disabled by default.
+*/
+void Fl::awake_coalesce(int v) {
+  awake_coalesce_ = v;
+}
+
+/** Returns non-zero if awake handlers are coalesced. \see awake_coalesce(int) */
+int Fl::awake_coalesce() {
+  return awake_coalesce_;
+}
+
+/**
+  Reports statistics about the awake handler queue.
+
+  \param[out] dropped number of awake(Fl_Awake_Handler, void*) calls
+               which failed because the queue was full
+  \param[out] high_water greatest number of handlers ever waiting in the
+               queue at once
+  \param[in] reset if non-zero, both counters are cleared afterwards
+*/
+void Fl::awake_stats(unsigned &dropped, unsigned &high_water, int reset) {
+  if (reset) {
+    dropped = __atomic_exchange_n(&awake_drops, 0u, __ATOMIC_RELAXED);
+    high_water = __atomic_exchange_n(&awake_high_water, 0u, __ATOMIC_RELAXED);
   } else {
-    func = awake_ring_[awake_ring_tail_];
-    data = awake_data_[awake_ring_tail_];
-    ++awake_ring_tail_;
-    if (awake_ring_tail_ == awake_ring_size_)
-      awake_ring_tail_ = 0;
+    dropped = __atomic_load_n(&awake_drops, __ATOMIC_RELAXED);
+    high_water = __atomic_load_n(&awake_high_water, __ATOMIC_RELAXED);
   }
-  unlock_ring();
-  return ret;
 }
 
 /**
@@ -128,12 +291,17 @@ int Fl::get_awake_handler_(Fl_Awake_Handler &func, void *&data)
  Returns 0 if the callback function was registered, 
  and -1 if registration failed. Over a thousand awake callbacks can be
  registered simultaneously.
+
+ This function never blocks and takes no locks, so it may be called
+ from realtime threads. Only the first of a burst of calls made before
+ the main thread runs the handlers causes a system call to wake it up.
  
- \see Fl::awake(void* message=0)
+ \see Fl::awake(void* message=0), Fl::awake_stats(), Fl::awake_coalesce()
 */
 int Fl::awake(Fl_Awake_Handler func, void *data) {
   int ret = add_awake_handler_(func, data);
-  Fl::awake();
+  if (!__atomic_exchange_n(&awake_pending, 1u, __ATOMIC_SEQ_CST))
+    Fl::awake();
   return ret;
 }
 
@@ -177,10 +345,16 @@ int Fl::awake(Fl_Awake_Handler func, void *data) {
     
     Multiple calls to Fl::awake() will queue multiple pointers 
     for the main thread to process, up to a system-defined (typically several 
-    thousand) depth. The default message handler saves the last message which 
+    thousand) depth. Each wakeup of the main thread delivers one of them, in
+    order. The default message handler saves the last message which 
     can be accessed using the 
     Fl::thread_message() function.
 
+    Where the wakeup is an eventfd, the pointers share the queue of
+    Fl::awake(Fl_Awake_Handler, void*), and messages which do not fit are
+    counted as dropped by Fl::awake_stats(). A NULL message only wakes
+    the main thread.
+
     In the context of a threaded application, a call to Fl::awake() with no
     argument will trigger event loop handling in the main thread. Since
     it is not possible to call Fl::flush() from a subsidiary thread,
@@ -202,19 +376,6 @@ static DWORD main_thread;
 
 // Microsoft's version of a MUTEX...
 CRITICAL_SECTION cs;
-CRITICAL_SECTION *cs_ring;
-
-void unlock_ring() {
-  LeaveCriticalSection(cs_ring);
-}
-
-void lock_ring() {
-  if (!cs_ring) {
-    cs_ring = (CRITICAL_SECTION*)malloc(sizeof(CRITICAL_SECTION));
-    InitializeCriticalSection(cs_ring);
-  }
-  EnterCriticalSection(cs_ring);
-}
 
 //
 // 'unlock_function()' - Release the lock.
@@ -259,10 +420,17 @@ void Fl::awake(void* msg) {
 #  include <unistd.h>
 #  include <fcntl.h>
 #  include <pthread.h>
+#  if HAVE_SYS_EVENTFD_H
+#    include <sys/eventfd.h>
+#    include <stdint.h>
+#  endif
 
-// Pipe for thread messaging via Fl::awake()...
+// Pipe (or eventfd) for thread messaging via Fl::awake()...
 static int thread_filedes[2];
 
+// Non-zero when thread_filedes[] holds a single eventfd rather than a pipe
+static int thread_eventfd;
+
 // Mutex and state information for Fl::lock() and Fl::unlock()...
 static pthread_mutex_t fltk_mutex;
 static pthread_t owner;
@@ -306,18 +474,33 @@ static void unlock_function_rec() {
 }
 #  endif // PTHREAD_MUTEX_RECURSIVE
 
+static void* thread_message_;
+
 void Fl::awake(void* msg) {
+#  if HAVE_SYS_EVENTFD_H
+  if (thread_eventfd) {
+    // the counter carries no data, so queue the message with the awake
+    // handlers and only use the eventfd to wake the main thread
+    if (msg) Fl::add_awake_handler_(thread_message_cb, msg);
+    uint64_t one = 1;
+    if (write(thread_filedes[1], &one, sizeof(one))==0) { /* ignore */ }
+    return;
+  }
+#  endif
   if (write(thread_filedes[1], &msg, sizeof(void*))==0) { /* ignore */ }
 }
 
-static void* thread_message_;
 void* Fl::thread_message() {
-  void* r = thread_message_;
-  thread_message_ = 0;
-  return r;
+  return __atomic_exchange_n(&thread_message_, (void*)0, __ATOMIC_ACQ_REL);
 }
 
 static void thread_awake_cb(int fd, void*) {
+#  if HAVE_SYS_EVENTFD_H
+  if (thread_eventfd) {
+    uint64_t count;
+    if (read(fd, &count, sizeof(count))==0) { /* ignore */ }
+  } else
+#  endif
   if (read(fd, &thread_message_, sizeof(void*))==0) { 
     /* This should never happen */
   }
@@ -326,6 +509,16 @@ static void thread_awake_cb(int fd, void*) {
   while (Fl::get_awake_handler_(func, data)==0) {
     (*func)(data);
   }
+#  if HAVE_SYS_EVENTFD_H
+  if (thread_eventfd && thread_messages_head != thread_messages_tail) {
+    thread_message_ = thread_messages[thread_messages_head++ & AWAKE_RING_MASK];
+    // come back for the next one after this Fl::wait() has returned
+    if (thread_messages_head != thread_messages_tail) {
+      uint64_t one = 1;
+      if (write(fd, &one, sizeof(one))==0) { /* ignore */ }
+    }
+  }
+#  endif
 }
 
 // These pointers are in Fl_x.cxx:
@@ -333,23 +526,40 @@ extern void (*fl_lock_function)();
 extern void (*fl_unlock_function)();
 
 int Fl::lock() {
-  if (!thread_filedes[1]) {
-    // Initialize thread communication pipe to let threads awake FLTK
-    // from Fl::wait()
-    if (pipe(thread_filedes)==-1) {
-      /* this should not happen */
+  if (!thread_filedes[1] && !thread_eventfd) {
+#  if HAVE_SYS_EVENTFD_H
+    // Prefer an eventfd, which needs a single descriptor and folds any
+    // number of pending wakeups into one counter
+    int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd >= 0) {
+      thread_filedes[0] = thread_filedes[1] = efd;
+      thread_eventfd = 1;
+    } else
+#  endif
+    {
+      // Initialize thread communication pipe to let threads awake FLTK
+      // from Fl::wait()
+      if (pipe(thread_filedes)==-1) {
+        /* this should not happen */
+      }
+
+      // Make the write side of the pipe non-blocking to avoid deadlock
+      // conditions (STR #1537)
+      fcntl(thread_filedes[1], F_SETFL,
+            fcntl(thread_filedes[1], F_GETFL) | O_NONBLOCK);
     }
 
-    // Make the write side of the pipe non-blocking to avoid deadlock
-    // conditions (STR #1537)
-    fcntl(thread_filedes[1], F_SETFL,
-          fcntl(thread_filedes[1], F_GETFL) | O_NONBLOCK);
-
     // Monitor the read side of the pipe so that messages sent via
     // Fl::awake() from a thread will "wake up" the main thread in
     // Fl::wait().
     Fl::add_fd(thread_filedes[0], FL_READ, thread_awake_cb);
 
+    // Handlers queued before there was a pipe to write to set
+    // awake_pending without waking anyone, which would keep any later
+    // call from waking the main thread. Clear it and send that wakeup.
+    if (__atomic_exchange_n(&awake_pending, 0u, __ATOMIC_SEQ_CST))
+      Fl::awake();
+
     // Set lock/unlock functions for this system, using a system-supplied
     // recursive mutex if supported...
 #  ifdef HAVE_PTHREAD_MUTEX_RECURSIVE
@@ -374,29 +584,8 @@ void Fl::unlock() {
   fl_unlock_function();
 }
 
-// Mutex code for the awake ring buffer
-static pthread_mutex_t *ring_mutex;
-
-void unlock_ring() {
-  pthread_mutex_unlock(ring_mutex);
-}
-
-void lock_ring() {
-  if (!ring_mutex) {
-    ring_mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
-    pthread_mutex_init(ring_mutex, NULL);
-  }
-  pthread_mutex_lock(ring_mutex);
-}
-
 #else
 
-void unlock_ring() {
-}
-
-void lock_ring() {
-}
-
 void Fl::awake(void*) {
 }
 
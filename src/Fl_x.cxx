@@ -76,9 +76,85 @@ fl_offscreen_get_dimensions ( Fl_Offscreen p, unsigned int *w, unsigned int *h )
 }
 
 ////////////////////////////////////////////////////////////////
-// interface to poll/select call:
+// interface to epoll/poll/select call:
 
-#  if USE_POLL
+#  if HAVE_SYS_EPOLL_H && !defined(FL_NO_EPOLL)
+#    define USE_EPOLL 1
+#  endif
+
+#  if USE_EPOLL
+
+/* On Linux the file descriptors are watched with epoll. The kernel
+   keeps the interest list, so adding and removing a descriptor is a
+   single epoll_ctl() call plus an O(1) update of a table indexed by
+   descriptor number, and fl_wait() only visits descriptors which are
+   actually ready. */
+
+#    include <sys/epoll.h>
+#    include <poll.h>
+#    include <errno.h>
+
+// at most one handler per event bit, since add_fd() removes the bits
+// it is about to add from any earlier handler for the same fd
+#    define FD_HANDLERS 3
+
+struct FD_Handler {
+  int events;
+  void (*cb)(int, void*);
+  void* arg;
+};
+
+struct FD_Slot {
+  int events;                   // union of the handlers' events
+  FD_Handler h[FD_HANDLERS];
+};
+
+static int epoll_fd = -1;
+static int epoll_failed = 0;    // no epoll, poll() the slots instead
+static FD_Slot *fd_slots = 0;
+static int fd_slots_size = 0;
+static epoll_event *epoll_events = 0;
+static int epoll_events_size = 0;
+
+static unsigned to_epoll_events(int events) {
+  unsigned e = 0;
+  if (events & POLLIN) e |= EPOLLIN;
+  if (events & POLLOUT) e |= EPOLLOUT;
+  if (events & POLLERR) e |= EPOLLERR;
+  return e;
+}
+
+static int from_epoll_events(unsigned e) {
+  int events = 0;
+  if (e & EPOLLIN) events |= POLLIN;
+  if (e & EPOLLOUT) events |= POLLOUT;
+  if (e & EPOLLERR) events |= POLLERR;
+  if (e & EPOLLHUP) events |= POLLHUP;
+  return events;
+}
+
+// tell the kernel about the new event mask of slot n
+static void update_epoll(int n, int old_events) {
+  if (epoll_fd < 0) return;
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.data.fd = n;
+  ev.events = to_epoll_events(fd_slots[n].events);
+
+  if (!fd_slots[n].events) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, n, &ev);
+  } else if (!old_events) {
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, n, &ev) < 0 && errno == EEXIST)
+      epoll_ctl(epoll_fd, EPOLL_CTL_MOD, n, &ev);
+  } else {
+    // the kernel forgets descriptors which were closed without calling
+    // remove_fd(), so the number may have been reused since
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, n, &ev) < 0 && errno == ENOENT)
+      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, n, &ev);
+  }
+}
+
+#  elif USE_POLL
 
 #    include <poll.h>
 static pollfd *pollfds = 0;
@@ -100,6 +176,7 @@ static int maxfd;
 #  endif /* USE_POLL */
 
 static int nfds = 0;
+#  if !USE_EPOLL
 static int fd_array_size = 0;
 struct FD {
 #  if !USE_POLL
@@ -111,6 +188,7 @@ struct FD {
 };
 
 static FD *fd = 0;
+#  endif // !USE_EPOLL
 
 /* XEMBED messages */
 #define XEMBED_EMBEDDED_NOTIFY		0
@@ -137,6 +215,71 @@ static FD *fd = 0;
 
 Window fl_parent_window = 0;                                    /* hack into Fl_X::make_xid() */
 
+#  if USE_EPOLL
+
+void Fl::add_fd(int n, int events, void (*cb)(int, void*), void *v) {
+  events &= POLLIN | POLLOUT | POLLERR;
+  if (n < 0 || !events) return;
+  remove_fd(n,events);
+
+  if (epoll_fd < 0 && !epoll_failed) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+      Fl::warning("Fl::add_fd(): epoll_create1() failed, using poll()");
+      epoll_failed = 1;
+    }
+  }
+
+  if (n >= fd_slots_size) {
+    int size = fd_slots_size ? fd_slots_size : 64;
+    while (size <= n) size *= 2;
+    FD_Slot *temp = (FD_Slot*)realloc(fd_slots, size*sizeof(FD_Slot));
+    if (!temp) return;
+    memset(temp + fd_slots_size, 0, (size - fd_slots_size)*sizeof(FD_Slot));
+    fd_slots = temp;
+    fd_slots_size = size;
+  }
+
+  FD_Slot *s = &fd_slots[n];
+  for (int i = 0; i < FD_HANDLERS; i++) {
+    if (s->h[i].events) continue;
+    s->h[i].events = events;
+    s->h[i].cb = cb;
+    s->h[i].arg = v;
+    break;
+  }
+
+  int old_events = s->events;
+  s->events |= events;
+  if (!old_events) nfds++;
+  update_epoll(n, old_events);
+}
+
+void Fl::add_fd(int n, void (*cb)(int, void*), void* v) {
+  Fl::add_fd(n, POLLIN, cb, v);
+}
+
+void Fl::remove_fd(int n, int events) {
+  if (n < 0 || n >= fd_slots_size) return;
+
+  FD_Slot *s = &fd_slots[n];
+  if (!s->events) return;
+
+  int old_events = s->events;
+  s->events = 0;
+  for (int i = 0; i < FD_HANDLERS; i++) {
+    s->h[i].events &= ~events;
+    if (!s->h[i].events) s->h[i].cb = 0;
+    s->events |= s->h[i].events;
+  }
+
+  if (s->events == old_events) return;
+  if (!s->events) nfds--;
+  update_epoll(n, old_events);
+}
+
+#  else
+
 void Fl::add_fd(int n, int events, void (*cb)(int, void*), void *v) {
   remove_fd(n,events);
   int i = nfds++;
@@ -216,6 +359,8 @@ void Fl::remove_fd(int n, int events) {
 #  endif
 }
 
+#  endif // USE_EPOLL
+
 void Fl::remove_fd(int n) {
   remove_fd(n, -1);
 }
@@ -250,6 +395,112 @@ void (*fl_unlock_function)() = nothing;
 // This is never called with time_to_wait < 0.0:
 // It should return negative on error, 0 if nothing happens before
 // timeout, and >0 if any callbacks were done.
+#  if USE_EPOLL
+
+// call the handlers of descriptor f which are interested in revents
+static void dispatch_fd(int f, int revents) {
+  if (f < 0 || f >= fd_slots_size) return;
+
+  // take a copy, the callbacks may add or remove handlers
+  FD_Handler h[FD_HANDLERS];
+  memcpy(h, fd_slots[f].h, sizeof(h));
+
+  for (int i = 0; i < FD_HANDLERS; i++) {
+    if (!h[i].cb) continue;
+    // like poll(), errors and hangups are reported to every handler
+    if (!(revents & (h[i].events | POLLERR | POLLHUP))) continue;
+
+    // skip handlers removed by an earlier callback
+    FD_Handler *c = &fd_slots[f].h[i];
+    if (c->cb != h[i].cb || c->arg != h[i].arg || !c->events) continue;
+
+    h[i].cb(f, h[i].arg);
+    if (f >= fd_slots_size) break;
+  }
+}
+
+// Without epoll, the slots are polled like the poll() version does
+static pollfd *poll_fds = 0;
+static int poll_fds_size = 0;
+
+// fill poll_fds from the slots, returns the number of descriptors
+static int fill_poll_fds() {
+  if (poll_fds_size < nfds) {
+    pollfd *temp = (pollfd*)realloc(poll_fds, nfds*sizeof(pollfd));
+    if (!temp) return 0;
+    poll_fds = temp;
+    poll_fds_size = nfds;
+  }
+  int i = 0;
+  for (int f = 0; f < fd_slots_size && i < nfds; f++) {
+    if (!fd_slots[f].events) continue;
+    poll_fds[i].fd = f;
+    poll_fds[i].events = fd_slots[f].events;
+    poll_fds[i].revents = 0;
+    i++;
+  }
+  return i;
+}
+
+int fl_wait(double time_to_wait) {
+
+  // OpenGL and other broken libraries call XEventsQueued
+  // unnecessarily and thus cause the file descriptor to not be ready,
+  // so we must check for already-read events:
+  if (fl_display && XQLength(fl_display)) {do_queued_events(); return 1;}
+
+  if (epoll_events_size < nfds) {
+    epoll_event *temp = (epoll_event*)realloc(epoll_events, nfds*sizeof(epoll_event));
+    if (temp) {
+      epoll_events = temp;
+      epoll_events_size = nfds;
+    }
+  }
+
+  int timeout = time_to_wait < 2147483.648 ? int(time_to_wait*1000 + .5) : -1;
+  int n;
+
+  if (epoll_failed) {
+    int count = fill_poll_fds();
+    fl_unlock_function();
+    n = ::poll(poll_fds, count, timeout);
+    fl_lock_function();
+    for (int i = 0; n > 0 && i < count; i++)
+      if (poll_fds[i].revents) dispatch_fd(poll_fds[i].fd, poll_fds[i].revents);
+    return n;
+  }
+
+  fl_unlock_function();
+
+  if (epoll_fd < 0 || !epoll_events_size) {
+    n = ::poll(0, 0, timeout);
+  } else {
+    n = epoll_wait(epoll_fd, epoll_events, epoll_events_size, timeout);
+  }
+
+  fl_lock_function();
+
+  for (int i = 0; i < n; i++)
+    dispatch_fd(epoll_events[i].data.fd, from_epoll_events(epoll_events[i].events));
+
+  return n;
+}
+
+// fl_ready() is just like fl_wait(0.0) except no callbacks are done:
+int fl_ready() {
+  if (XQLength(fl_display)) return 1;
+  if (epoll_failed) return ::poll(poll_fds, fill_poll_fds(), 0);
+  if (!nfds || epoll_fd < 0) return 0; // nothing to poll
+  // the epoll descriptor itself becomes readable when any watched
+  // descriptor is ready
+  pollfd p;
+  p.fd = epoll_fd;
+  p.events = POLLIN;
+  return ::poll(&p, 1, 0);
+}
+
+#  else
+
 int fl_wait(double time_to_wait) {
 
   // OpenGL and other broken libraries call XEventsQueued
@@ -321,6 +572,8 @@ int fl_ready() {
 #  endif
 }
 
+#  endif // USE_EPOLL
+
 // replace \r\n by \n
 static void convert_crlf(unsigned char *string, long& len) {
   unsigned char *a, *b;
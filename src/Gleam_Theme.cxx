@@ -60,7 +60,7 @@ static void shade_rect_up(int x, int y, int w, int h, Fl_Color bc)
     }
 
     gleam_color(bc);
-    fl_rectf( x, y + j, x + w - 1, h - j );
+    fl_rectf( x, y + j, w, h - j );
 }
 
 static void frame_rect_up(int x, int y, int w, int h, Fl_Color bc)
@@ -149,18 +149,23 @@ static void border_box(int x, int y, int w, int h, Fl_Color c)
     fl_rect(x+1,y+1,w-2,h-2);
 }
 
+FL_THEME_CACHED_BOX( up_box )
+FL_THEME_CACHED_BOX( down_box )
+FL_THEME_CACHED_BOX( up_frame )
+FL_THEME_CACHED_BOX( down_frame )
+
 static void
 init_theme ( void )
 {
     /* replace the gtk+ boxes... (is there a better way?) */
-    Fl::set_boxtype(  FL_UP_BOX,         up_box,           2,2,4,4 );
-    Fl::set_boxtype(  FL_DOWN_BOX,       down_box,         2,2,3,3 );
-    Fl::set_boxtype(  FL_THIN_UP_BOX,         up_box,           2,2,3,3 );
-    Fl::set_boxtype(  FL_THIN_DOWN_BOX,       down_box,         2,2,3,3 );
-    Fl::set_boxtype(  FL_UP_FRAME,       up_frame,         2,2,3,3 );
-    Fl::set_boxtype(  FL_DOWN_FRAME,     down_frame,       2,2,3,3 );
-    Fl::set_boxtype(  FL_ROUND_UP_BOX,   up_box,           2,2,3,3 );
-    Fl::set_boxtype(  FL_ROUND_DOWN_BOX, down_box,         2,2,3,3 );
+    Fl::set_boxtype(  FL_UP_BOX,         cached_up_box,           2,2,4,4 );
+    Fl::set_boxtype(  FL_DOWN_BOX,       cached_down_box,         2,2,3,3 );
+    Fl::set_boxtype(  FL_THIN_UP_BOX,         cached_up_box,           2,2,3,3 );
+    Fl::set_boxtype(  FL_THIN_DOWN_BOX,       cached_down_box,         2,2,3,3 );
+    Fl::set_boxtype(  FL_UP_FRAME,       cached_up_frame,         2,2,3,3 );
+    Fl::set_boxtype(  FL_DOWN_FRAME,     cached_down_frame,       2,2,3,3 );
+    Fl::set_boxtype(  FL_ROUND_UP_BOX,   cached_up_box,           2,2,3,3 );
+    Fl::set_boxtype(  FL_ROUND_DOWN_BOX, cached_down_box,         2,2,3,3 );
     Fl::set_boxtype(  FL_BORDER_BOX,       border_box,      1,1,2,2 );
 }
 
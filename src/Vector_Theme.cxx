@@ -150,17 +150,22 @@ static void border_box(int x, int y, int w, int h, Fl_Color bc)
     fl_rect( x, y, w, h, bc );
 }
 
+FL_THEME_CACHED_BOX( up_box )
+FL_THEME_CACHED_BOX( down_box )
+FL_THEME_CACHED_BOX( up_frame )
+FL_THEME_CACHED_BOX( down_frame )
+
 static void
 init_theme ( void )
 {
-    Fl::set_boxtype(  FL_UP_BOX,         up_box,             DX,DX,DX*2,DX*2  );
-    Fl::set_boxtype(  FL_DOWN_BOX,       down_box,           DX,DX,DX*2,DX*2  );
-    Fl::set_boxtype(  FL_THIN_UP_BOX,    up_box,             DX,DX,DX*2,DX*2  );
-    Fl::set_boxtype(  FL_THIN_DOWN_BOX,  down_box,           DX,DX,DX*2,DX*2  );
-    Fl::set_boxtype(  FL_UP_FRAME,       up_frame,           DX,DX,DX*2,DX*2  );
-    Fl::set_boxtype(  FL_DOWN_FRAME,     down_frame,         DX,DX,DX*2,DX*2  );
-    Fl::set_boxtype(  FL_ROUND_UP_BOX,   up_box,             DX,DX,DX*2,DX*2  );
-    Fl::set_boxtype(  FL_ROUND_DOWN_BOX, down_box,           DX,DX,DX*2,DX*2  );
+    Fl::set_boxtype(  FL_UP_BOX,         cached_up_box,             DX,DX,DX*2,DX*2  );
+    Fl::set_boxtype(  FL_DOWN_BOX,       cached_down_box,           DX,DX,DX*2,DX*2  );
+    Fl::set_boxtype(  FL_THIN_UP_BOX,    cached_up_box,             DX,DX,DX*2,DX*2  );
+    Fl::set_boxtype(  FL_THIN_DOWN_BOX,  cached_down_box,           DX,DX,DX*2,DX*2  );
+    Fl::set_boxtype(  FL_UP_FRAME,       cached_up_frame,           DX,DX,DX*2,DX*2  );
+    Fl::set_boxtype(  FL_DOWN_FRAME,     cached_down_frame,         DX,DX,DX*2,DX*2  );
+    Fl::set_boxtype(  FL_ROUND_UP_BOX,   cached_up_box,             DX,DX,DX*2,DX*2  );
+    Fl::set_boxtype(  FL_ROUND_DOWN_BOX, cached_down_box,           DX,DX,DX*2,DX*2  );
     Fl::set_boxtype(  FL_BORDER_BOX,     border_box,         1,1,2,2  );
 }
 
@@ -64,6 +64,22 @@
 #  include "fl_font_x.cxx"
 #endif // WIN32
 
+#if defined(WIN32) || defined(__APPLE__) || !USE_XFT
+// only the Xft text path has a text run cache
+void fl_text_cache_limit(unsigned long) {}
+void fl_text_cache_stats(unsigned long &hits, unsigned long &misses, unsigned long &bytes) {
+  hits = misses = bytes = 0;
+}
+#endif
+
+#if !defined(WIN32) && !defined(__APPLE__) && !USE_XFT
+#include <cairo/cairo.h>
+// without Xft, Fl_Cairo_Graphics_Driver always draws text with Xlib
+int fl_cairo_draw_text(cairo_t *, Fl_Font_Descriptor *, const char *, int, int, int) {
+  return 0;
+}
+#endif
+
 
 double fl_width(const char* c) {
   if (c) return fl_width(c, strlen(c));
@@ -64,6 +64,8 @@
 #ifndef FL_DOXYGEN
 
 #include <X11/Xft/Xft.h>
+#include <cairo/cairo.h>
+#include <cairo/cairo-ft.h>
 
 #include <math.h>
 
@@ -373,8 +375,173 @@ static const wchar_t *utf8reformat(const char *str, int& n)
   return buffer;
 }
 
+/*
+  Text run cache.
+
+  Labels, browser lines and text display lines are measured and drawn
+  over and over with the same font and contents. Each distinct (font,
+  string) pair is converted to glyph indices and measured once, then
+  kept in a hash table with least-recently-used eviction, so that
+  measuring or drawing it again costs a hash lookup.
+
+  Fonts are never closed, so the XftFont pointer is a stable key.
+*/
+
+struct Fl_Text_Run {
+  XftFont *font;
+  unsigned hash;
+  int len;                      // bytes of UTF-8 text
+  char *str;
+  XGlyphInfo extents;
+  int nglyphs;
+  FT_UInt *glyphs;
+  short *advances;              // per glyph, filled in by the cairo text path
+  int have_advances;
+  unsigned long bytes;          // memory accounted to this entry
+  Fl_Text_Run *chain;           // next in hash bucket
+  Fl_Text_Run *prev, *next;     // LRU list, most recent first
+};
+
+// runs longer than this are not worth keeping
+static const int TEXT_RUN_MAX_LEN = 1024;
+static const unsigned TEXT_RUN_BUCKETS = 4096;
+
+static Fl_Text_Run *text_run_table[TEXT_RUN_BUCKETS];
+static Fl_Text_Run *text_run_first, *text_run_last;
+static unsigned long text_run_limit = 2 * 1024 * 1024;
+static unsigned long text_run_bytes;
+static unsigned long text_run_hits, text_run_misses;
+
+static unsigned text_run_hash(XftFont *font, const char *str, int n) {
+  // FNV-1a, seeded with the font
+  unsigned h = 2166136261u ^ (unsigned)((unsigned long)font >> 4);
+  for (int i = 0; i < n; i++) {
+    h ^= (unsigned char)str[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static void text_run_unlink(Fl_Text_Run *r) {
+  if (r->prev) r->prev->next = r->next; else text_run_first = r->next;
+  if (r->next) r->next->prev = r->prev; else text_run_last = r->prev;
+  r->prev = r->next = 0;
+}
+
+static void text_run_push(Fl_Text_Run *r) {
+  r->prev = 0;
+  r->next = text_run_first;
+  if (text_run_first) text_run_first->prev = r; else text_run_last = r;
+  text_run_first = r;
+}
+
+static void text_run_free(Fl_Text_Run *r) {
+  Fl_Text_Run **p = &text_run_table[r->hash & (TEXT_RUN_BUCKETS - 1)];
+  while (*p != r) p = &(*p)->chain;
+  *p = r->chain;
+  text_run_unlink(r);
+  text_run_bytes -= r->bytes;
+  free(r);
+}
+
+static void text_run_trim(unsigned long limit) {
+  while (text_run_last && text_run_bytes > limit)
+    text_run_free(text_run_last);
+}
+
+// Returns the cached run for str in desc's font, creating it if
+// needed. Returns NULL if the string is too long to be cached.
+static Fl_Text_Run *text_run(Fl_Font_Descriptor *desc, const char *str, int n) {
+  if (n > TEXT_RUN_MAX_LEN || !text_run_limit) return 0;
+
+  XftFont *font = desc->font;
+  unsigned h = text_run_hash(font, str, n);
+
+  Fl_Text_Run **bucket = &text_run_table[h & (TEXT_RUN_BUCKETS - 1)];
+  for (Fl_Text_Run *r = *bucket; r; r = r->chain) {
+    if (r->hash == h && r->font == font && r->len == n && !memcmp(r->str, str, n)) {
+      text_run_hits++;
+      if (r != text_run_first) {
+        text_run_unlink(r);
+        text_run_push(r);
+      }
+      return r;
+    }
+  }
+
+  text_run_misses++;
+
+  int nc = n;
+  const wchar_t *buffer = utf8reformat(str, nc);
+
+  // one allocation holds the entry, its glyphs and a copy of the text
+  unsigned long bytes = sizeof(Fl_Text_Run) + nc * (sizeof(FT_UInt) + sizeof(short)) + n;
+  Fl_Text_Run *r = (Fl_Text_Run*)malloc(bytes);
+  if (!r) return 0;
+
+  r->font = font;
+  r->hash = h;
+  r->len = n;
+  r->nglyphs = nc;
+  r->glyphs = (FT_UInt*)(r + 1);
+  r->advances = (short*)(r->glyphs + nc);
+  r->have_advances = 0;
+  r->str = (char*)(r->advances + nc);
+  r->bytes = bytes;
+  memcpy(r->str, str, n);
+
+  for (int i = 0; i < nc; i++)
+    r->glyphs[i] = XftCharIndex(fl_display, font, (FcChar32)buffer[i]);
+
+  memset(&r->extents, 0, sizeof(XGlyphInfo));
+  if (nc) XftGlyphExtents(fl_display, font, r->glyphs, nc, &r->extents);
+
+  r->chain = *bucket;
+  *bucket = r;
+  text_run_push(r);
+  text_run_bytes += bytes;
+
+  text_run_trim(text_run_limit);
+
+  return r;
+}
+
+/**
+  Sets the amount of memory the Xft text run cache may use.
+
+  Measured and drawn strings are cached per font, so that measuring
+  or drawing an unchanged string again does not need to convert and
+  measure it again. Least recently used strings are discarded once the
+  cache uses more than \p bytes. The default is 2MB, 0 disables the
+  cache.
+*/
+void fl_text_cache_limit(unsigned long bytes) {
+  text_run_limit = bytes;
+  text_run_trim(bytes);
+}
+
+/**
+  Reports statistics of the text run cache.
+  \param[out] hits, misses number of lookups which were answered from the
+               cache and which had to measure the string
+  \param[out] bytes memory currently used by the cache
+  \see fl_text_cache_limit()
+*/
+void fl_text_cache_stats(unsigned long &hits, unsigned long &misses, unsigned long &bytes) {
+  hits = text_run_hits;
+  misses = text_run_misses;
+  bytes = text_run_bytes;
+}
+
 static void utf8extents(Fl_Font_Descriptor *desc, const char *str, int n, XGlyphInfo *extents)
 {
+#ifndef __CYGWIN__
+  Fl_Text_Run *r = text_run(desc, str, n);
+  if (r) {
+    *extents = r->extents;
+    return;
+  }
+#endif
   memset(extents, 0, sizeof(XGlyphInfo));
   const wchar_t *buffer = utf8reformat(str, n);
 #ifdef __CYGWIN__
@@ -621,11 +788,17 @@ void Fl_Xlib_Graphics_Driver::draw(const char *str, int n, int x, int y) {
   color.color.blue  = ((int)b)*0x101;
   color.color.alpha = 0xffff;
   
-  const wchar_t *buffer = utf8reformat(str, n);
 #ifdef __CYGWIN__
+  const wchar_t *buffer = utf8reformat(str, n);
   XftDrawString16(draw_, &color, font_descriptor()->font, x, y, (XftChar16 *)buffer, n);
 #else
-  XftDrawString32(draw_, &color, font_descriptor()->font, x, y, (XftChar32 *)buffer, n);
+  Fl_Text_Run *run = text_run(font_descriptor(), str, n);
+  if (run) {
+    XftDrawGlyphs(draw_, &color, font_descriptor()->font, x, y, run->glyphs, run->nglyphs);
+  } else {
+    const wchar_t *buffer = utf8reformat(str, n);
+    XftDrawString32(draw_, &color, font_descriptor()->font, x, y, (XftChar32 *)buffer, n);
+  }
 #endif
 
   if ( region ) XDestroyRegion( region );
@@ -637,6 +810,131 @@ void Fl_Xlib_Graphics_Driver::draw(int angle, const char *str, int n, int x, int
   fl_xft_font(this, this->Fl_Graphics_Driver::font(), this->size(), 0);
 }
 
+/*
+  Text drawing for Fl_Cairo_Graphics_Driver.
+
+  Glyphs are drawn with cairo_show_glyphs() through cairo-ft font faces
+  made from the fontconfig pattern Xft matched for the font, so labels
+  go into the same cairo context as the surrounding shapes instead of
+  being drawn by Xft behind cairo's back. Glyph indices come from the
+  text run cache and glyph positions from the Xft advances, so the
+  result lines up with what fl_width() reports.
+
+  The scaled fonts are shared by all windows and, like the Xft fonts
+  they are made from, are never freed.
+*/
+
+struct Fl_Cairo_Font {
+  XftFont *font;
+  cairo_scaled_font_t *scaled;  // NULL if cairo could not load the font
+  Fl_Cairo_Font *next;
+};
+
+static const unsigned CAIRO_FONT_BUCKETS = 64;
+static Fl_Cairo_Font *cairo_font_table[CAIRO_FONT_BUCKETS];
+
+static cairo_scaled_font_t *cairo_scaled_font(Fl_Font_Descriptor *desc) {
+  XftFont *font = desc->font;
+  Fl_Cairo_Font **bucket = &cairo_font_table[((unsigned long)font >> 4) & (CAIRO_FONT_BUCKETS - 1)];
+  for (Fl_Cairo_Font *f = *bucket; f; f = f->next)
+    if (f->font == font) return f->scaled;
+
+  double px;
+  if (FcPatternGetDouble(font->pattern, FC_PIXEL_SIZE, 0, &px) != FcResultMatch)
+    px = desc->size;
+
+  cairo_font_face_t *face = cairo_ft_font_face_create_for_pattern(font->pattern);
+  cairo_matrix_t fm, ctm;
+  cairo_matrix_init_scale(&fm, px, px);
+  cairo_matrix_init_identity(&ctm);
+  // the rest of the rendering options come from the pattern itself
+  cairo_font_options_t *options = cairo_font_options_create();
+  cairo_font_options_set_hint_metrics(options, CAIRO_HINT_METRICS_ON);
+  cairo_scaled_font_t *scaled = cairo_scaled_font_create(face, &fm, &ctm, options);
+  cairo_font_options_destroy(options);
+  cairo_font_face_destroy(face);
+  if (cairo_scaled_font_status(scaled) != CAIRO_STATUS_SUCCESS) {
+    cairo_scaled_font_destroy(scaled);
+    scaled = 0;
+  }
+
+  Fl_Cairo_Font *f = new Fl_Cairo_Font;
+  f->font = font;
+  f->scaled = scaled;
+  f->next = *bucket;
+  *bucket = f;
+  return scaled;
+}
+
+static short glyph_advance(XftFont *font, FT_UInt glyph) {
+  XGlyphInfo gi;
+  XftGlyphExtents(fl_display, font, &glyph, 1, &gi);
+  return gi.xOff;
+}
+
+static cairo_glyph_t *glyph_buffer;
+static int glyph_buffer_size;
+
+/*
+  Draws str with cairo into cr at x, y. Returns 0 if this font or
+  situation is not handled here, in which case the caller should draw
+  with Xft instead.
+*/
+int fl_cairo_draw_text(cairo_t *cr, Fl_Font_Descriptor *desc, const char *str, int n, int x, int y) {
+#if USE_OVERLAY
+  if (fl_overlay) return 0;
+#endif
+  // rotated fonts are left to Xft, their matrix lives in the pattern
+  if (desc->angle) return 0;
+  cairo_scaled_font_t *scaled = cairo_scaled_font(desc);
+  if (!scaled) return 0;
+
+  XftFont *font = desc->font;
+  Fl_Text_Run *run = text_run(desc, str, n);
+  int ng = run ? run->nglyphs : n;
+
+  if (ng > glyph_buffer_size) {
+    cairo_glyph_t *b = (cairo_glyph_t*)realloc(glyph_buffer, ng * sizeof(cairo_glyph_t));
+    if (!b) return 0;
+    glyph_buffer = b;
+    glyph_buffer_size = ng;
+  }
+
+  double pos = x;
+  if (run) {
+    if (!run->have_advances) {
+      for (int i = 0; i < ng; i++)
+        run->advances[i] = glyph_advance(font, run->glyphs[i]);
+      run->have_advances = 1;
+    }
+    for (int i = 0; i < ng; i++) {
+      glyph_buffer[i].index = run->glyphs[i];
+      glyph_buffer[i].x = pos;
+      glyph_buffer[i].y = y;
+      pos += run->advances[i];
+    }
+  } else {
+    const wchar_t *buffer = utf8reformat(str, ng);
+    for (int i = 0; i < ng; i++) {
+      FT_UInt glyph = XftCharIndex(fl_display, font, (FcChar32)buffer[i]);
+      glyph_buffer[i].index = glyph;
+      glyph_buffer[i].x = pos;
+      glyph_buffer[i].y = y;
+      pos += glyph_advance(font, glyph);
+    }
+  }
+  if (!ng) return 1;
+
+  // like the Xft path, text is not affected by the drawing matrix
+  cairo_matrix_t matrix;
+  cairo_get_matrix(cr, &matrix);
+  cairo_identity_matrix(cr);
+  cairo_set_scaled_font(cr, scaled);
+  cairo_show_glyphs(cr, glyph_buffer, ng);
+  cairo_set_matrix(cr, &matrix);
+  return 1;
+}
+
 static void fl_drawUCS4(Fl_Graphics_Driver *driver, const FcChar32 *str, int n, int x, int y) {
 #if USE_OVERLAY
   XftDraw*& draw_ = fl_overlay ? draw_overlay : ::draw_;
@@ -44,6 +44,7 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Widget.H>
 #include <FL/Fl_Button.H>
+#include <FL/Fl_Menu_.H>
 #include <FL/fl_draw.H>
 #include <ctype.h>
 #include "flstring.h"
@@ -381,6 +382,180 @@ int Fl_Widget::test_shortcut() {
   return test_shortcut(label());
 }
 
+////////////////////////////////////////////////////////////////
+// Shortcut registry:
+//
+// Fl::handle() sends FL_SHORTCUT to the widgets registered under the
+// key that was pressed before broadcasting it to the whole widget
+// tree. Widgets are registered under the key of their shortcut(), the
+// '&x' character of their label, and, for menus, the keys of all their
+// items. The key is stored lower-cased and without shift flags, so a
+// lookup only yields candidates: every one of them still decides in
+// its handle() whether the event is its shortcut.
+
+enum { SHORTCUT_KEY, SHORTCUT_LABEL, SHORTCUT_MENU };
+
+struct Fl_Shortcut_Node {
+  Fl_Shortcut_Node* next_key;	// chain of the key's bucket
+  Fl_Shortcut_Node* next_widget;	// chain of the widget's bucket
+  Fl_Widget* w;
+  unsigned key;
+  int kind;
+};
+
+#define SHORTCUT_BUCKETS 512
+
+static Fl_Shortcut_Node* shortcut_keys[SHORTCUT_BUCKETS];
+static Fl_Shortcut_Node* shortcut_widgets[SHORTCUT_BUCKETS];
+
+// menus whose items have to be registered again:
+static Fl_Menu_** changed_menus;
+static int num_changed_menus, alloc_changed_menus;
+
+static unsigned key_bucket(unsigned key) {
+  return (key * 2654435761U >> 16) % SHORTCUT_BUCKETS;
+}
+
+static unsigned widget_bucket(const Fl_Widget* w) {
+  return (unsigned)((unsigned long)w >> 4) % SHORTCUT_BUCKETS;
+}
+
+static unsigned shortcut_key(unsigned c) {
+  return (unsigned)fl_tolower(c & FL_KEY_MASK);
+}
+
+static void add_shortcut(Fl_Widget* w, unsigned key, int kind) {
+  if (!key) return;
+  Fl_Shortcut_Node** p;
+  // menus have many items on the same key, only enter them once:
+  for (p = &shortcut_widgets[widget_bucket(w)]; *p; p = &(*p)->next_widget)
+    if ((*p)->w == w && (*p)->key == key && (*p)->kind == kind) return;
+  Fl_Shortcut_Node* n = new Fl_Shortcut_Node;
+  n->w = w;
+  n->key = key;
+  n->kind = kind;
+  n->next_widget = 0;
+  *p = n;
+  unsigned b = key_bucket(key);
+  n->next_key = shortcut_keys[b];
+  shortcut_keys[b] = n;
+}
+
+// removes the registrations of w of the given kind, or all for -1
+static void remove_shortcuts(Fl_Widget* w, int kind) {
+  Fl_Shortcut_Node** p = &shortcut_widgets[widget_bucket(w)];
+  while (*p) {
+    Fl_Shortcut_Node* n = *p;
+    if (n->w != w || (kind >= 0 && n->kind != kind)) {
+      p = &n->next_widget;
+      continue;
+    }
+    *p = n->next_widget;
+    Fl_Shortcut_Node** q = &shortcut_keys[key_bucket(n->key)];
+    while (*q != n) q = &(*q)->next_key;
+    *q = n->next_key;
+    delete n;
+  }
+}
+
+/** \internal
+  Registers \p w under the key of its shortcut() \p s.
+*/
+void fl_shortcut_register(Fl_Widget* w, int s) {
+  remove_shortcuts(w, SHORTCUT_KEY);
+  if (s) add_shortcut(w, shortcut_key(s), SHORTCUT_KEY);
+}
+
+/** \internal
+  Registers \p w under the '&x' shortcut of its label, if it has one
+  and \p enabled is set because the widget uses label shortcuts.
+*/
+void fl_shortcut_register_label(Fl_Widget* w, int enabled) {
+  remove_shortcuts(w, SHORTCUT_LABEL);
+  if (enabled)
+    add_shortcut(w, shortcut_key(Fl_Widget::label_shortcut(w->label())),
+		 SHORTCUT_LABEL);
+}
+
+/** \internal
+  Notes that the items of menu \p m changed. The menu is registered
+  under their keys again before the next shortcut is dispatched.
+*/
+void fl_shortcut_menu_changed(Fl_Menu_* m) {
+  for (int i = 0; i < num_changed_menus; i++)
+    if (changed_menus[i] == m) return;
+  if (num_changed_menus >= alloc_changed_menus) {
+    alloc_changed_menus = alloc_changed_menus ? 2 * alloc_changed_menus : 16;
+    changed_menus = (Fl_Menu_**)realloc(changed_menus,
+					alloc_changed_menus * sizeof(Fl_Menu_*));
+  }
+  changed_menus[num_changed_menus++] = m;
+}
+
+/** \internal
+  Forgets all registrations of \p w, called when it is deleted.
+*/
+void fl_shortcut_unregister(Fl_Widget* w) {
+  remove_shortcuts(w, -1);
+  for (int i = 0; i < num_changed_menus; i++)
+    if (changed_menus[i] == (Fl_Menu_*)w) {
+      changed_menus[i] = changed_menus[--num_changed_menus];
+      break;
+    }
+}
+
+static void register_menu_items(Fl_Menu_* w, const Fl_Menu_Item* m, int depth) {
+  if (!m || depth > 8) return;
+  for (int level = 0;; m++) {
+    if (!m->text) {
+      if (!level--) return;
+      continue;
+    }
+    add_shortcut(w, shortcut_key(m->shortcut()), SHORTCUT_MENU);
+    add_shortcut(w, shortcut_key(Fl_Widget::label_shortcut(m->text)),
+		 SHORTCUT_MENU);
+    if (m->flags & FL_SUBMENU_POINTER)
+      register_menu_items(w, (const Fl_Menu_Item*)m->user_data(), depth + 1);
+    else if (m->flags & FL_SUBMENU)
+      level++;
+  }
+}
+
+/** \internal
+  Stores up to \p size widgets registered under the key of the current
+  event in \p buf and returns how many there are.
+*/
+int fl_shortcut_candidates(Fl_Widget** buf, int size) {
+  int i, j, n = 0;
+
+  for (i = 0; i < num_changed_menus; i++) {
+    remove_shortcuts(changed_menus[i], SHORTCUT_MENU);
+    register_menu_items(changed_menus[i], changed_menus[i]->menu(), 0);
+  }
+  num_changed_menus = 0;
+
+  // the keys Fl::test_shortcut() and Fl_Widget::test_shortcut() compare:
+  unsigned keys[3];
+  int nkeys = 0;
+  unsigned c = fl_utf8decode(Fl::event_text(), Fl::event_text()+Fl::event_length(), 0);
+  keys[nkeys++] = shortcut_key(Fl::event_key());
+  if (c) keys[nkeys++] = shortcut_key(c);
+  if (Fl::event_state(FL_CTRL) && c && c < 0x20) keys[nkeys++] = shortcut_key(c ^ 0x40);
+
+  for (i = 0; i < nkeys; i++) {
+    for (j = 0; j < i; j++) if (keys[j] == keys[i]) break;
+    if (j < i) continue;
+    for (Fl_Shortcut_Node* p = shortcut_keys[key_bucket(keys[i])]; p; p = p->next_key) {
+      if (p->key != keys[i]) continue;
+      for (j = 0; j < n; j++) if (buf[j] == p->w) break;
+      if (j < n) continue;
+      if (n >= size) return n;
+      buf[n++] = p->w;
+    }
+  }
+  return n;
+}
+
 //
 // End of "$Id: fl_shortcut.cxx 8621 2011-04-23 15:46:30Z AlbrechtS $".
 //
@@ -0,0 +1,115 @@
+//
+// "$Id$"
+//
+// Text rendering benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Redraws a window full of labelled boxes a number of times, once with
+// labels drawn by Xft and once with the cairo glyph path, and reports
+// the average time per frame for each.
+//
+// Usage: text_bench [frames]
+//
+// Copyright 1998-2010 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Box.H>
+#include <FL/x.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static const int COLS = 12;
+static const int ROWS = 30;
+static const int CELL_W = 70;
+static const int CELL_H = 20;
+
+static Fl_Group *grid;
+static Fl_Box *status;
+static int frames = 200;
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// returns the average time per frame in milliseconds
+static double run(int cairo_text) {
+  fl_set_cairo_text(cairo_text);
+  // draw once so both paths start with warm font and text caches
+  grid->redraw();
+  Fl::flush();
+  XSync(fl_display, False);
+
+  double start = now();
+  for (int i = 0; i < frames; i++) {
+    grid->redraw();
+    Fl::flush();
+    XSync(fl_display, False);
+  }
+  return (now() - start) * 1000.0 / frames;
+}
+
+static void bench_cb(void *) {
+  double xft = run(0);
+  double cairo = run(1);
+
+  static char buf[128];
+  snprintf(buf, sizeof(buf), "%d frames: Xft %.2f ms/frame, cairo %.2f ms/frame",
+           frames, xft, cairo);
+  printf("%s\n", buf);
+  status->label(buf);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) frames = atoi(argv[1]);
+  if (frames < 1) frames = 1;
+
+  Fl_Double_Window window(COLS * CELL_W, ROWS * CELL_H + 30, "text_bench");
+  grid = new Fl_Group(0, 0, COLS * CELL_W, ROWS * CELL_H);
+  static char labels[ROWS][COLS][16];
+  for (int r = 0; r < ROWS; r++) {
+    for (int c = 0; c < COLS; c++) {
+      snprintf(labels[r][c], sizeof(labels[r][c]), "Item %d.%d", r, c);
+      Fl_Box *b = new Fl_Box(c * CELL_W, r * CELL_H, CELL_W, CELL_H, labels[r][c]);
+      // mix shapes in with the labels, the way real widgets do
+      b->box((r + c) & 1 ? FL_ROUND_UP_BOX : FL_THIN_DOWN_BOX);
+      b->labelsize(10 + (r + c) % 4);
+      b->labelfont(c % 3 ? FL_HELVETICA : FL_TIMES);
+    }
+  }
+  grid->end();
+  status = new Fl_Box(0, ROWS * CELL_H, COLS * CELL_W, 30, "Running...");
+  status->align(FL_ALIGN_INSIDE | FL_ALIGN_LEFT);
+  window.end();
+  window.show(argc > 1 ? 1 : argc, argv);
+
+  Fl::add_timeout(0.5, bench_cb);
+  return Fl::run();
+}
+
+//
+// End of "$Id$".
+//